@@ -0,0 +1,81 @@
+#include "../database/table.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// Скорость чтения чанков с диска в форматах csv, binary и columnar на одних и тех же данных.
+// Запросы читают резидентные чанки, поэтому файлы целиком сканируются при открытии таблицы:
+// замеряется открытие, а для сравнения — полный обход строк в памяти.
+// Запуск: scan_bench [строк] [повторов]
+static Table* openTable(const string& directory, const string& format)
+{
+    TableOptions options;
+    options.format = format;
+    return new Table("order", Vector<string>{"user_id", "pair_id", "quantity", "price", "type", "closed"},
+                     directory, 10000, options);
+}
+
+int main(int argc, char* argv[])
+{
+    const int rows = argc > 1 ? stoi(argv[1]) : 1000000;
+    const int repeats = argc > 2 ? stoi(argv[2]) : 5;
+    char pattern[] = "/tmp/scan_bench_XXXXXX";
+    const string root = mkdtemp(pattern);
+    {
+        ofstream csv(root + "/rows.csv");
+        for (int i = 0; i < rows; i++) {
+            csv << i % 1000 << "," << i % 20 << "," << (i * 7) % 100000 << ".125," << 10 + i % 90 << ".5,"
+                << (i % 2 == 0 ? "buy" : "sell") << "," << (i % 3 == 0 ? to_string(1700000000 + i) : "0") << "\n";
+        }
+    }
+    cout << "format     open, ms   rows/s (open)   scan, ms   rows/s (scan)" << endl;
+    for (const string format: {"csv", "binary", "columnar"})
+    {
+        const string directory = root + "/" + format;
+        streambuf* console = cout.rdbuf();
+        ostringstream quiet;
+        cout.rdbuf(quiet.rdbuf());
+        Table* table = openTable(directory, format);
+        table->copyFrom(root + "/rows.csv");
+        delete table;
+
+        // Берётся лучший из повторов: первый прогревает кеш страниц
+        double openMs = 0;
+        double scanMs = 0;
+        size_t seen = 0;
+        for (int repeat = 0; repeat < repeats; repeat++)
+        {
+            quiet.str("");
+            const auto start = chrono::steady_clock::now();
+            table = openTable(directory, format);
+            const auto opened = chrono::steady_clock::now();
+            size_t bytes = 0;
+            table->forEachRow([&bytes](const RowView& row) {
+                for (size_t column = 0; column < row.size(); column++) {
+                    bytes += row[column].size();
+                }
+            });
+            if (bytes == 0) {
+                cerr << format << ": пустой обход" << endl;
+            }
+            const auto scanned = chrono::steady_clock::now();
+            seen = table->rowCount();
+            delete table;
+            const double openTime = chrono::duration<double, milli>(opened - start).count();
+            const double scanTime = chrono::duration<double, milli>(scanned - opened).count();
+            openMs = repeat == 0 ? openTime : min(openMs, openTime);
+            scanMs = repeat == 0 ? scanTime : min(scanMs, scanTime);
+        }
+        cout.rdbuf(console);
+        if (seen != static_cast<size_t>(rows)) {
+            cerr << format << ": прочитано строк " << seen << " из " << rows << endl;
+            return 1;
+        }
+        printf("%-8s %10.1f %16.0f %10.1f %15.0f\n", format.c_str(), openMs, rows / openMs * 1000,
+               scanMs, rows / scanMs * 1000);
+    }
+    remove_all(root);
+    return 0;
+}
@@ -0,0 +1,290 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+#include <cstddef>
+
+// B+дерево уникальных записей T, упорядоченных компаратором Less.
+// Листья связаны в двусвязный список для обхода в обе стороны. Удаление
+// не сливает узлы: опустевшие листья пропускаются при обходе и исчезают
+// при следующей перестройке индекса
+template<typename T, typename Less, int FANOUT = 64>
+class BPlusTree
+{
+private:
+    struct Node
+    {
+        bool leaf = true;
+        int count = 0;
+        // В листе — записи, во внутреннем узле — count разделителей и count + 1 потомков
+        T entries[FANOUT];
+        Node* children[FANOUT + 1] = {};
+        Node* next = nullptr;
+        Node* prev = nullptr;
+    };
+
+    Node* root = nullptr;
+    size_t entryCount = 0;
+    size_t nodeCount = 0;
+    Less less;
+
+    // Номер первого разделителя, строго большего entry
+    int upperBound(const Node* node, const T& entry) const
+    {
+        int low = 0, high = node->count;
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            if (less(entry, node->entries[mid])) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+        return low;
+    }
+
+    int lowerBound(const Node* node, const T& entry) const
+    {
+        int low = 0, high = node->count;
+        while (low < high) {
+            const int mid = (low + high) / 2;
+            if (less(node->entries[mid], entry)) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    Node* findLeaf(const T& entry) const
+    {
+        Node* node = root;
+        while (node != nullptr && !node->leaf) {
+            node = node->children[upperBound(node, entry)];
+        }
+        return node;
+    }
+
+    Node* newNode(const bool leaf)
+    {
+        Node* node = new Node();
+        node->leaf = leaf;
+        nodeCount++;
+        return node;
+    }
+
+    // Вставляет запись в поддерево; при расщеплении возвращает правый узел и разделитель
+    Node* insertInto(Node* node, const T& entry, T& separator, bool& inserted)
+    {
+        if (node->leaf)
+        {
+            const int pos = lowerBound(node, entry);
+            if (pos < node->count && !less(entry, node->entries[pos])) {
+                inserted = false;
+                return nullptr;
+            }
+            for (int i = node->count; i > pos; i--) {
+                node->entries[i] = node->entries[i - 1];
+            }
+            node->entries[pos] = entry;
+            node->count++;
+            inserted = true;
+            if (node->count < FANOUT) {
+                return nullptr;
+            }
+            Node* right = newNode(true);
+            const int half = node->count / 2;
+            for (int i = half; i < node->count; i++) {
+                right->entries[i - half] = node->entries[i];
+            }
+            right->count = node->count - half;
+            node->count = half;
+            right->next = node->next;
+            right->prev = node;
+            if (node->next != nullptr) {
+                node->next->prev = right;
+            }
+            node->next = right;
+            separator = right->entries[0];
+            return right;
+        }
+
+        const int childPos = upperBound(node, entry);
+        T childSeparator;
+        Node* split = insertInto(node->children[childPos], entry, childSeparator, inserted);
+        if (split == nullptr) {
+            return nullptr;
+        }
+        for (int i = node->count; i > childPos; i--) {
+            node->entries[i] = node->entries[i - 1];
+            node->children[i + 1] = node->children[i];
+        }
+        node->entries[childPos] = childSeparator;
+        node->children[childPos + 1] = split;
+        node->count++;
+        if (node->count < FANOUT) {
+            return nullptr;
+        }
+        Node* right = newNode(false);
+        const int half = node->count / 2;
+        separator = node->entries[half];
+        for (int i = half + 1; i < node->count; i++) {
+            right->entries[i - half - 1] = node->entries[i];
+        }
+        for (int i = half + 1; i <= node->count; i++) {
+            right->children[i - half - 1] = node->children[i];
+        }
+        right->count = node->count - half - 1;
+        node->count = half;
+        return right;
+    }
+
+    void destroy(Node* node)
+    {
+        if (node == nullptr) {
+            return;
+        }
+        if (!node->leaf) {
+            for (int i = 0; i <= node->count; i++) {
+                destroy(node->children[i]);
+            }
+        }
+        delete node;
+    }
+
+public:
+    // Позиция записи в листе; невалидна, когда node == nullptr
+    class Cursor
+    {
+    private:
+        const Node* node = nullptr;
+        int pos = 0;
+        friend class BPlusTree;
+        Cursor(const Node* n, const int p) : node(n), pos(p) {}
+        void skipForward()
+        {
+            while (node != nullptr && pos >= node->count) {
+                node = node->next;
+                pos = 0;
+            }
+        }
+        void skipBackward()
+        {
+            while (node != nullptr && pos < 0) {
+                node = node->prev;
+                pos = node != nullptr ? node->count - 1 : 0;
+            }
+        }
+    public:
+        Cursor() = default;
+        [[nodiscard]] bool valid() const {return node != nullptr;}
+        [[nodiscard]] const T& get() const {return node->entries[pos];}
+        void advance() {pos++; skipForward();}
+        void retreat() {pos--; skipBackward();}
+    };
+
+    BPlusTree() = default;
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    bool insert(const T& entry)
+    {
+        if (root == nullptr) {
+            root = newNode(true);
+        }
+        T separator;
+        bool inserted = false;
+        Node* split = insertInto(root, entry, separator, inserted);
+        if (split != nullptr)
+        {
+            Node* newRoot = newNode(false);
+            newRoot->entries[0] = separator;
+            newRoot->children[0] = root;
+            newRoot->children[1] = split;
+            newRoot->count = 1;
+            root = newRoot;
+        }
+        if (inserted) {
+            entryCount++;
+        }
+        return inserted;
+    }
+
+    bool erase(const T& entry)
+    {
+        Node* leaf = findLeaf(entry);
+        if (leaf == nullptr) {
+            return false;
+        }
+        const int pos = lowerBound(leaf, entry);
+        if (pos >= leaf->count || less(entry, leaf->entries[pos])) {
+            return false;
+        }
+        for (int i = pos; i + 1 < leaf->count; i++) {
+            leaf->entries[i] = leaf->entries[i + 1];
+        }
+        leaf->count--;
+        entryCount--;
+        return true;
+    }
+
+    // Первая запись, не меньшая entry
+    Cursor lowerBound(const T& entry) const
+    {
+        const Node* leaf = findLeaf(entry);
+        if (leaf == nullptr) {
+            return Cursor();
+        }
+        Cursor cursor(leaf, lowerBound(leaf, entry));
+        cursor.skipForward();
+        return cursor;
+    }
+
+    // Последняя запись, строго меньшая entry
+    Cursor before(const T& entry) const
+    {
+        const Node* leaf = findLeaf(entry);
+        if (leaf == nullptr) {
+            return Cursor();
+        }
+        Cursor cursor(leaf, lowerBound(leaf, entry) - 1);
+        cursor.skipBackward();
+        return cursor;
+    }
+
+    Cursor first() const
+    {
+        const Node* node = root;
+        while (node != nullptr && !node->leaf) {
+            node = node->children[0];
+        }
+        Cursor cursor(node, 0);
+        cursor.skipForward();
+        return cursor;
+    }
+
+    Cursor last() const
+    {
+        const Node* node = root;
+        while (node != nullptr && !node->leaf) {
+            node = node->children[node->count];
+        }
+        Cursor cursor(node, node != nullptr ? node->count - 1 : 0);
+        cursor.skipBackward();
+        return cursor;
+    }
+
+    void clear()
+    {
+        destroy(root);
+        root = nullptr;
+        entryCount = 0;
+        nodeCount = 0;
+    }
+
+    [[nodiscard]] size_t size() const {return entryCount;}
+    [[nodiscard]] size_t memoryUsage() const {return sizeof(BPlusTree) + nodeCount * sizeof(Node);}
+
+    ~BPlusTree() {destroy(root);}
+};
+
+#endif //BPLUSTREE_H
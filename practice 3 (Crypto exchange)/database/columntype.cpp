@@ -0,0 +1,304 @@
+#include "columntype.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+ColumnType ColumnType::parse(const string& declaration)
+{
+    string upper = declaration;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    ColumnType type;
+    if (upper == "TEXT") {
+        return type;
+    }
+    if (upper == "INT") {
+        type.kind = INT;
+        return type;
+    }
+    // DECIMAL(p,s): точность ограничена int64_t, масштаб — числом знаков после точки
+    int precision = 0;
+    int scale = 0;
+    char tail = 0;
+    if (sscanf(upper.c_str(), "DECIMAL(%d,%d%c", &precision, &scale, &tail) == 3 && tail == ')' &&
+        precision > 0 && precision <= 18 && scale >= 0 && scale <= precision) {
+        type.kind = DECIMAL;
+        type.precision = precision;
+        type.scale = scale;
+        return type;
+    }
+    throw runtime_error("Неизвестный тип колонки: " + declaration);
+}
+
+string ColumnType::name() const
+{
+    if (kind == INT) {
+        return "INT";
+    }
+    if (kind == DECIMAL) {
+        return "DECIMAL(" + to_string(precision) + "," + to_string(scale) + ")";
+    }
+    return "TEXT";
+}
+
+bool ColumnType::parseValue(string_view text, int64_t& number) const
+{
+    if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front()) {
+        text = text.substr(1, text.size() - 2);
+    }
+    size_t pos = 0;
+    const bool negative = pos < text.size() && text[pos] == '-';
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+        pos++;
+    }
+    int64_t value = 0;
+    int digits = 0;
+    int fraction = -1;
+    for (; pos < text.size(); pos++)
+    {
+        const char c = text[pos];
+        if (c == '.' && fraction == -1 && kind == DECIMAL) {
+            fraction = 0;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        digits++;
+        if (fraction != -1)
+        {
+            if (fraction == scale) {
+                if (c != '0') {
+                    return false;
+                }
+                continue;
+            }
+            fraction++;
+        }
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, c - '0', &value)) {
+            return false;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    int64_t limit = 1;
+    for (int i = 0; i < precision; i++) {
+        limit *= 10;
+    }
+    for (int i = max(fraction, 0); i < scale; i++) {
+        if (__builtin_mul_overflow(value, 10, &value) || value >= limit) {
+            return false;
+        }
+    }
+    if (kind == DECIMAL && value >= limit) {
+        return false;
+    }
+    number = negative ? -value : value;
+    return true;
+}
+
+string ColumnType::format(const int64_t number) const
+{
+    if (kind != DECIMAL || scale == 0) {
+        return to_string(number);
+    }
+    // Модуль через uint64_t, чтобы не переполниться на INT64_MIN
+    const uint64_t magnitude = number < 0 ? 0 - static_cast<uint64_t>(number) : static_cast<uint64_t>(number);
+    string digits = to_string(magnitude);
+    if (digits.size() <= static_cast<size_t>(scale)) {
+        digits.insert(0, scale + 1 - digits.size(), '0');
+    }
+    digits.insert(digits.size() - scale, 1, '.');
+    return number < 0 ? "-" + digits : digits;
+}
+
+string ColumnType::canonical(const string& text) const
+{
+    if (!isNumeric()) {
+        return text;
+    }
+    int64_t number = 0;
+    if (!parseValue(text, number)) {
+        throw runtime_error("Значение " + text + " не подходит для типа " + name());
+    }
+    return format(number);
+}
+
+// Десятичное число любой длины для арифметики над TEXT: модуль цифрами без точки и число знаков дроби
+struct DecimalText
+{
+    bool negative = false;
+    string digits;
+    int scale = 0;
+};
+
+// Показатель степени ограничен, чтобы запись вроде 1E999999999 не раздувала строку цифр
+static constexpr int MAX_DECIMAL_EXPONENT = 4096;
+
+// Принимает 12.5, -0.001, 1E-8, 2.5e+3 и те же значения в кавычках
+static bool parseDecimalText(string_view text, DecimalText& decimal)
+{
+    if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front()) {
+        text = text.substr(1, text.size() - 2);
+    }
+    size_t pos = 0;
+    decimal = DecimalText();
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+        decimal.negative = text[pos] == '-';
+        pos++;
+    }
+    int fraction = -1;
+    for (; pos < text.size() && text[pos] != 'e' && text[pos] != 'E'; pos++)
+    {
+        const char c = text[pos];
+        if (c == '.' && fraction == -1) {
+            fraction = 0;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        decimal.digits.push_back(c);
+        if (fraction != -1) {
+            fraction++;
+        }
+    }
+    if (decimal.digits.empty()) {
+        return false;
+    }
+    int exponent = 0;
+    if (pos < text.size())
+    {
+        pos++;
+        const bool negativeExponent = pos < text.size() && text[pos] == '-';
+        if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+            pos++;
+        }
+        if (pos == text.size()) {
+            return false;
+        }
+        for (; pos < text.size(); pos++)
+        {
+            if (text[pos] < '0' || text[pos] > '9') {
+                return false;
+            }
+            exponent = exponent * 10 + (text[pos] - '0');
+            if (exponent > MAX_DECIMAL_EXPONENT) {
+                return false;
+            }
+        }
+        exponent = negativeExponent ? -exponent : exponent;
+    }
+    decimal.scale = max(fraction, 0) - exponent;
+    if (decimal.scale < 0) {
+        decimal.digits.append(-decimal.scale, '0');
+        decimal.scale = 0;
+    }
+    const size_t significant = decimal.digits.find_first_not_of('0');
+    decimal.digits.erase(0, significant == string::npos ? decimal.digits.size() - 1 : significant);
+    return true;
+}
+
+static int compareMagnitude(const string& left, const string& right)
+{
+    if (left.size() != right.size()) {
+        return left.size() < right.size() ? -1 : 1;
+    }
+    return left.compare(right);
+}
+
+// Сумма со знаками; модули выровнены по масштабу и записаны без ведущих нулей
+static DecimalText addDecimalText(const DecimalText& left, const DecimalText& right)
+{
+    DecimalText result;
+    result.scale = left.scale;
+    if (left.negative == right.negative)
+    {
+        result.negative = left.negative;
+        int carry = 0;
+        for (size_t i = 0; i < max(left.digits.size(), right.digits.size()) || carry != 0; i++)
+        {
+            const int a = i < left.digits.size() ? left.digits[left.digits.size() - 1 - i] - '0' : 0;
+            const int b = i < right.digits.size() ? right.digits[right.digits.size() - 1 - i] - '0' : 0;
+            result.digits.push_back(static_cast<char>('0' + (a + b + carry) % 10));
+            carry = (a + b + carry) / 10;
+        }
+    } else
+    {
+        // Из большего модуля вычитается меньший, знак берётся у большего
+        const bool swap = compareMagnitude(left.digits, right.digits) < 0;
+        const DecimalText& larger = swap ? right : left;
+        const DecimalText& smaller = swap ? left : right;
+        result.negative = larger.negative;
+        int borrow = 0;
+        for (size_t i = 0; i < larger.digits.size(); i++)
+        {
+            int digit = larger.digits[larger.digits.size() - 1 - i] - '0' - borrow;
+            digit -= i < smaller.digits.size() ? smaller.digits[smaller.digits.size() - 1 - i] - '0' : 0;
+            borrow = digit < 0 ? 1 : 0;
+            result.digits.push_back(static_cast<char>('0' + digit + borrow * 10));
+        }
+    }
+    while (result.digits.size() > 1 && result.digits.back() == '0') {
+        result.digits.pop_back();
+    }
+    reverse(result.digits.begin(), result.digits.end());
+    return result;
+}
+
+static string formatDecimalText(DecimalText decimal)
+{
+    if (decimal.digits.size() <= static_cast<size_t>(decimal.scale)) {
+        decimal.digits.insert(0, decimal.scale + 1 - decimal.digits.size(), '0');
+    }
+    const bool zero = decimal.digits.find_first_not_of('0') == string::npos;
+    if (decimal.scale > 0) {
+        decimal.digits.insert(decimal.digits.size() - decimal.scale, 1, '.');
+    }
+    return decimal.negative && !zero ? "-" + decimal.digits : decimal.digits;
+}
+
+string ColumnType::arithmetic(const string& left, const char operation, const string& right) const
+{
+    if (kind == TEXT)
+    {
+        DecimalText a;
+        DecimalText b;
+        if (!parseDecimalText(left, a)) {
+            throw runtime_error("Значение " + left + " не является числом");
+        }
+        if (!parseDecimalText(right, b)) {
+            throw runtime_error("Значение " + right + " не является числом");
+        }
+        for (DecimalText* operand: {&a, &b})
+        {
+            const int scale = max(a.scale, b.scale);
+            if (operand->digits != "0") {
+                operand->digits.append(scale - operand->scale, '0');
+            }
+            operand->scale = scale;
+        }
+        if (operation == '-') {
+            b.negative = !b.negative;
+        }
+        return formatDecimalText(addDecimalText(a, b));
+    }
+    int64_t a = 0;
+    int64_t b = 0;
+    if (!parseValue(left, a)) {
+        throw runtime_error("Значение " + left + " не подходит для типа " + name());
+    }
+    if (!parseValue(right, b)) {
+        throw runtime_error("Значение " + right + " не подходит для типа " + name());
+    }
+    int64_t result = 0;
+    const bool overflow = operation == '-' ? __builtin_sub_overflow(a, b, &result) : __builtin_add_overflow(a, b, &result);
+    int64_t limit = 1;
+    for (int i = 0; i < precision; i++) {
+        limit *= 10;
+    }
+    if (overflow || (kind == DECIMAL && (result >= limit || result <= -limit))) {
+        throw runtime_error("Результат " + left + " " + operation + " " + right + " не помещается в тип " + name());
+    }
+    return format(result);
+}
@@ -0,0 +1,30 @@
+#ifndef COLUMNTYPE_H
+#define COLUMNTYPE_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Тип колонки из schema.json: TEXT, INT или DECIMAL(p,s).
+// INT и DECIMAL хранятся в памяти как int64_t; DECIMAL — в единицах 10^-scale
+struct ColumnType
+{
+    enum Kind { TEXT, INT, DECIMAL };
+    Kind kind = TEXT;
+    int precision = 0;
+    int scale = 0;
+
+    static ColumnType parse(const string& declaration);
+    [[nodiscard]] bool isNumeric() const {return kind != TEXT;}
+    [[nodiscard]] string name() const;
+    // Литерал может быть в кавычках; лишние цифры дроби допускаются, только если это нули
+    bool parseValue(string_view text, int64_t& number) const;
+    [[nodiscard]] string format(int64_t number) const;
+    // Каноническая запись значения: так оно хранится на диске и попадает в индексы
+    [[nodiscard]] string canonical(const string& text) const;
+    // left + right или left - right в записи этого типа. Для TEXT значения считаются точно как
+    // десятичные числа любой длины (в том числе 1E-8) с масштабом большего из операндов
+    [[nodiscard]] string arithmetic(const string& left, char operation, const string& right) const;
+};
+
+#endif //COLUMNTYPE_H
@@ -1,5 +1,6 @@
 #include "database.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include "vector.h"
 #include <vector>
@@ -14,17 +15,222 @@ void Database::loadSchema()
 
     name = data["name"];
     tuplesLimit = data["tuples_limit"];
+    vacuumThreshold = data.value("vacuum_threshold", vacuumThreshold);
+    maintenanceIntervalMs = data.value("maintenance_interval_ms", maintenanceIntervalMs);
+    gcIntervalMs = max(1, data.value("gc_interval_ms", gcIntervalMs));
+    pkCache = max(1, data.value("pk_cache", pkCache));
+    lockTimeoutMs = max(1, data.value("lock_timeout_ms", lockTimeoutMs));
+    importDirectory = data.value("import_directory", string());
     json structure = data["structure"];
+    json indexes = data.value("indexes", json::object());
+    json bloomFilters = data.value("bloom_filters", json::object());
+    json dictionaries = data.value("dictionary", json::object());
+    json partitionBy = data.value("partition_by", json::object());
+    const int defaultPartitions = data.value("partitions", 8);
     directory = name;
 
     for (const auto& table: structure.items())
     {
         string tableName = table.key();
-        Vector columns = table.value().get<vector<string>>();
-        Table* tableObj = new Table(tableName, columns, directory, tuplesLimit);
+        TableOptions options;
+        options.vacuumThreshold = vacuumThreshold;
+        options.pkCache = pkCache;
+        options.lockTimeoutMs = lockTimeoutMs;
+        Vector<string> columns;
+        if (table.value().is_array()) {
+            columns = table.value().get<vector<string>>();
+        } else {
+            columns = table.value()["columns"].get<vector<string>>();
+            options.format = table.value().value("format", options.format);
+            // "types": {"quantity": "DECIMAL(18,8)", "user_id": "INT"}; неуказанные колонки — TEXT
+            const json types = table.value().value("types", json::object());
+            for (const auto& type: types.items()) {
+                bool known = false;
+                for (const string& column: columns) {
+                    known = known || column == type.key();
+                }
+                if (!known) {
+                    throw runtime_error("Тип задан для неизвестной колонки " + tableName + "." + type.key());
+                }
+            }
+            for (const string& column: columns) {
+                options.types.push_back(ColumnType::parse(types.value(column, string("TEXT"))));
+            }
+        }
+        // Индекс задаётся именем колонки, списком колонок для составного ключа
+        // или объектом {"columns": [...], "type": "hash" | "btree"}
+        if (indexes.contains(tableName)) {
+            for (const auto& index: indexes[tableName]) {
+                IndexDefinition definition;
+                if (index.is_string()) {
+                    definition.columns.push_back(index.get<string>());
+                } else if (index.is_array()) {
+                    definition.columns = index.get<vector<string>>();
+                } else {
+                    definition.columns = index["columns"].get<vector<string>>();
+                    definition.type = index.value("type", definition.type);
+                }
+                options.indexes.push_back(definition);
+            }
+        }
+        if (bloomFilters.contains(tableName)) {
+            options.bloomColumns = bloomFilters[tableName].get<vector<string>>();
+        }
+        if (dictionaries.contains(tableName)) {
+            options.dictionaryColumns = dictionaries[tableName].get<vector<string>>();
+        }
+        // Партиции задаются именем колонки (их число — по умолчанию)
+        // или объектом {"column": "pair_id", "partitions": 16}
+        if (partitionBy.contains(tableName))
+        {
+            const json& partitioning = partitionBy[tableName];
+            options.partitions = defaultPartitions;
+            if (partitioning.is_string()) {
+                options.partitionColumn = partitioning.get<string>();
+            } else {
+                options.partitionColumn = partitioning["column"].get<string>();
+                options.partitions = partitioning.value("partitions", options.partitions);
+            }
+            if (options.partitions < 1) {
+                throw runtime_error("Число партиций таблицы '" + tableName + "' должно быть положительным");
+            }
+        }
+        Table* tableObj = new Table(tableName, columns, directory, tuplesLimit, options);
+        tableObj->setClock(&clock);
         tables.addElement(tableName, tableObj);
     }
     file.close();
+
+    wal = new WriteAheadLog(directory + "/wal.log", clock);
+    recover();
+    for (Table* table: getAllTables()) {
+        table->setWal(wal);
+    }
+}
+
+void Database::recover()
+{
+    const Vector<WalRecord> records = wal->readAll();
+    for (const WalRecord& record: records)
+    {
+        Table* table = tables.findElement(record.table);
+        if (table == nullptr || record.fields.empty()) {
+            continue;
+        }
+        if (record.type == WriteAheadLog::INSERT) {
+            table->replayInsert(record.fields);
+        } else if (record.type == WriteAheadLog::DELETE) {
+            table->replayDelete(record.fields);
+        } else if (record.type == WriteAheadLog::UPDATE) {
+            table->replayUpdate(record.fields);
+        }
+    }
+    if (!records.empty()) {
+        cout << "Восстановлено записей из журнала: " << records.size() << endl;
+    }
+    checkpoint();
+}
+
+void Database::checkpoint()
+{
+    // Пока держится исключительная блокировка, новые записи в журнал не попадают:
+    // всё, что в нём есть, переносится в чанки, после чего журнал очищается
+    unique_lock<shared_mutex> gate = wal->checkpointLock();
+    wal->sync();
+    for (Table* table: getAllTables()) {
+        table->flush();
+        try {
+            table->vacuum();
+        } catch (const exception& e) {
+            cerr << "Ошибка очистки таблицы '" << table->getName() << "': " << e.what() << endl;
+        }
+    }
+    wal->truncate();
+}
+
+Database::~Database()
+{
+    {
+        lock_guard<mutex> lock(maintenanceMutex);
+        stopping = true;
+    }
+    maintenanceWakeup.notify_all();
+    if (maintenanceThread.joinable()) {
+        maintenanceThread.join();
+    }
+    if (gcThread.joinable()) {
+        gcThread.join();
+    }
+    collectGarbage();
+    try {
+        checkpoint();
+    } catch (const exception& e) {
+        cerr << "Ошибка контрольной точки: " << e.what() << endl;
+    }
+    for (Table* table: getAllTables()) {
+        table->saveNextKey();
+    }
+    delete wal;
+}
+
+void Database::maintenanceLoop()
+{
+    unique_lock<mutex> lock(maintenanceMutex);
+    while (!stopping)
+    {
+        maintenanceWakeup.wait_for(lock, chrono::milliseconds(maintenanceIntervalMs));
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        try {
+            checkpoint();
+        } catch (const exception& e) {
+            cerr << "Ошибка контрольной точки: " << e.what() << endl;
+        }
+        lock.lock();
+    }
+}
+
+int Database::collectGarbage()
+{
+    const uint64_t horizon = clock.horizon();
+    int collected = 0;
+    for (Table* table: getAllTables()) {
+        collected += table->collectGarbage(horizon);
+    }
+    return collected;
+}
+
+void Database::collectLoop()
+{
+    unique_lock<mutex> lock(maintenanceMutex);
+    while (!stopping)
+    {
+        maintenanceWakeup.wait_for(lock, chrono::milliseconds(gcIntervalMs));
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        try {
+            collectGarbage();
+        } catch (const exception& e) {
+            cerr << "Ошибка сборки старых версий: " << e.what() << endl;
+        }
+        lock.lock();
+    }
+}
+
+Vector<Table*> Database::getAllTables() const
+{
+    Vector<Table*> result;
+    NodeHash** cells = tables.getCells();
+    for (int i = 0; i < tables.getCapacity(); i++) {
+        for (const NodeHash* node = cells[i]; node != nullptr; node = node->getNext()) {
+            result.push_back(node->getData());
+        }
+    }
+    return result;
 }
 
 Table* Database::getTable(const string& tableName) const
@@ -39,8 +245,12 @@ Table* Database::getTable(const string& tableName) const
 
 string Database::executeInsert(const SQLQuery& query) {
     Table* table = getTable(query.insertTable);
-    table->insertData(query.insertValues);
-    string message = "SUCCESS: Данные вставлены в таблицу '" + query.insertTable + "'\n";
+    table->insertData(query.insertRows);
+    string message = "SUCCESS: Данные вставлены в таблицу '" + query.insertTable + "'";
+    if (query.insertRows.size() > 1) {
+        message += ", строк: " + to_string(query.insertRows.size());
+    }
+    message += "\n";
     cout << message;
     return message;
 }
@@ -48,14 +258,61 @@ string Database::executeInsert(const SQLQuery& query) {
 string Database::executeDelete(const SQLQuery& query) {
     Table* table = getTable(query.deleteTable);
     table->deleteData(query.deleteConditions);
-    if (table->selectAllSafe().size() == 1) {
-        table->resetPK();
-    }
     string message = "SUCCESS: Данные удалены из таблицы '" + query.deleteTable + "'\n";
     cout << message;
     return message;
 }
 
+string Database::executeUpdate(const SQLQuery& query) {
+    Table* table = getTable(query.updateTable);
+    const size_t rows = table->updateData(query.updateAssignments, query.updateConditions);
+    string message = "SUCCESS: Данные обновлены в таблице '" + query.updateTable + "', строк: " + to_string(rows) + "\n";
+    cout << message;
+    return message;
+}
+
+string Database::resolveImportPath(const string& requested) const
+{
+    if (importDirectory.empty()) {
+        throw runtime_error("COPY отключён: в schema.json не задан import_directory");
+    }
+    const path relative(requested);
+    if (relative.empty() || relative.has_root_name() || relative.has_root_directory()) {
+        throw runtime_error("COPY принимает только путь относительно каталога импорта");
+    }
+    for (const path& part: relative) {
+        if (part == "..") {
+            throw runtime_error("Путь COPY не может содержать '..'");
+        }
+    }
+    path root;
+    path resolved;
+    try
+    {
+        root = weakly_canonical(absolute(importDirectory));
+        if (root.filename().empty()) {
+            root = root.parent_path();
+        }
+        // Ссылки разворачиваются, поэтому файл должен оказаться внутри каталога и после этого
+        resolved = weakly_canonical(root / relative);
+    } catch (const filesystem_error&) {
+        throw runtime_error("Не удалось разрешить путь COPY");
+    }
+    const auto [rootEnd, resolvedEnd] = mismatch(root.begin(), root.end(), resolved.begin(), resolved.end());
+    if (rootEnd != root.end() || resolvedEnd == resolved.end()) {
+        throw runtime_error("Путь COPY должен указывать на файл внутри каталога импорта");
+    }
+    return resolved.string();
+}
+
+string Database::executeCopy(const SQLQuery& query) {
+    Table* table = getTable(query.copyTable);
+    const size_t rows = table->copyFrom(resolveImportPath(query.copyPath));
+    string message = "SUCCESS: В таблицу '" + query.copyTable + "' загружено строк: " + to_string(rows) + "\n";
+    cout << message;
+    return message;
+}
+
 int getColIndex(const Vector<string>& headers, const string& colName) {
     for (int i = 0; i < headers.size(); i++) {
         if (headers[i] == colName) return i;
@@ -63,106 +320,137 @@ int getColIndex(const Vector<string>& headers, const string& colName) {
     return -1;
 }
 
-bool Database::checkConditionJoined(const Condition& condition, const Vector<string>& headers, const Vector<string>& row)
+void Database::splitConjuncts(Condition* condition, Vector<Condition*>& conjuncts)
 {
-    if (condition.getSign() == "AND")
+    if (condition->getSign() == "AND" && condition->getLeft() && condition->getRight())
     {
-        if (!condition.getLeft() || !condition.getRight()) {
-            return false;
-        }
-
-        return checkConditionJoined(*condition.getLeft(), headers, row) &&
-               checkConditionJoined(*condition.getRight(), headers, row);
+        splitConjuncts(condition->getLeft(), conjuncts);
+        splitConjuncts(condition->getRight(), conjuncts);
+        return;
     }
+    conjuncts.push_back(condition);
+}
 
-    if (condition.getSign() == "OR")
+int Database::conditionTable(const Condition& condition, const Vector<string>& headers,
+                             const Vector<int>& headerTables, bool& literal)
+{
+    if (condition.getSign() == "AND" || condition.getSign() == "OR")
     {
-        if (!condition.getLeft() && !condition.getRight()) {
-            return false;
+        if (!condition.getLeft() || !condition.getRight()) {
+            return -1;
         }
-        return checkConditionJoined(*condition.getLeft(), headers, row) ||
-               checkConditionJoined(*condition.getRight(), headers, row);
+        const int left = conditionTable(*condition.getLeft(), headers, headerTables, literal);
+        const int right = conditionTable(*condition.getRight(), headers, headerTables, literal);
+        return left == right ? left : -1;
     }
-
-    if (condition.getSign() == "=")
-    {
-        const int leftIdx = getColIndex(headers, condition.getName());
-        string rightVal = condition.getValue();
-        const int rightIdx = getColIndex(headers, condition.getValue());
-        const string leftVal = (leftIdx != -1 && leftIdx < row.size()) ? row[leftIdx] : "";
-        if (rightIdx != -1 && rightIdx < row.size()) {
-            rightVal = row[rightIdx];
-        }
-        return leftVal == rightVal;
+    // Имя колонки разрешается, как при проверке склеенной строки: по первому вхождению
+    const int column = getColIndex(headers, condition.getName());
+    if (column == -1) {
+        return -1;
     }
-    return false;
-}
-
-bool Database::checkWhereJoined(const Vector<Condition*>& conditions, const Vector<string>& headers, const Vector<string>& row)
-{
-    if (conditions.empty()) return true;
-    for (const Condition* cond: conditions) {
-        if (!checkConditionJoined(*cond, headers, row)) return false;
+    const int reference = getColIndex(headers, condition.getValue());
+    if (reference == -1) {
+        return headerTables[column];
     }
-    return true;
+    literal = false;
+    return headerTables[column] == headerTables[reference] ? headerTables[column] : -1;
 }
 
-void Database::executeJoinRecursive(
-    const SQLQuery& query,
-    size_t tableIndex,
-    const Vector<string>& currentHeaders,
-    const Vector<string>& currentRow,
-    Vector<Vector<string>>& result)
+void Database::collectJoinKeys(const Condition& condition, const Vector<string>& leftHeaders,
+                               const Vector<string>& rightHeaders, Vector<int>& leftKeys, Vector<int>& rightKeys)
 {
-    if (tableIndex >= query.fromTables.size()) {
-        if (checkWhereJoined(query.whereConditions, currentHeaders, currentRow)) {
-            Vector<string> filteredRow;
-            for (const string& colName: query.selectColumns) {
-                int colIdx = getColIndex(currentHeaders, colName);
-                if (colIdx != -1 && colIdx < currentRow.size()) {
-                    filteredRow.push_back(currentRow[colIdx]);
-                }
-            }
-            result.push_back(filteredRow);
+    // Ключ соединения — только равенство колонок, от которого зависит всё условие:
+    // ветви AND, но не OR
+    if (condition.getSign() == "AND")
+    {
+        if (condition.getLeft() && condition.getRight()) {
+            collectJoinKeys(*condition.getLeft(), leftHeaders, rightHeaders, leftKeys, rightKeys);
+            collectJoinKeys(*condition.getRight(), leftHeaders, rightHeaders, leftKeys, rightKeys);
         }
         return;
     }
-
-    Table* currentTable = getTable(query.fromTables[tableIndex]);
-    Vector<string> tableColumns = currentTable->getColumns();
-
-    Vector<string> newHeaders = currentHeaders;
-    for (const string& col: tableColumns) {
-        newHeaders.push_back(query.fromTables[tableIndex] + "." + col);
+    if (condition.getSign() != "=") {
+        return;
     }
+    // Имя, которое есть и слева (таблица соединяется сама с собой), условие относит к левой копии
+    auto rightOnly = [&](const string& column) {
+        return getColIndex(leftHeaders, column) == -1 ? getColIndex(rightHeaders, column) : -1;
+    };
+    int left = getColIndex(leftHeaders, condition.getName());
+    int right = rightOnly(condition.getValue());
+    if (left == -1 || right == -1)
+    {
+        left = getColIndex(leftHeaders, condition.getValue());
+        right = rightOnly(condition.getName());
+    }
+    if (left != -1 && right != -1) {
+        leftKeys.push_back(left);
+        rightKeys.push_back(right);
+    }
+}
 
-    string tablePath = currentTable->getPath();
-    int fileIndex = 1;
-
-    while (true) {
-        string filePath = tablePath + "/" + to_string(fileIndex) + ".csv";
-        ifstream file(filePath);
-
-        if (!file.is_open()) {
-            break;
+void Database::joinTable(Vector<Vector<string>>& joined, const Vector<Vector<string>>& rows,
+                         const Vector<int>& leftKeys, const Vector<int>& rightKeys)
+{
+    // Пары (строка слева, строка справа) в порядке вложенных циклов: слева внешний
+    Vector<pair<size_t, size_t>> matches;
+    if (leftKeys.empty())
+    {
+        // Без равенства колонок остаётся только перебор всех пар
+        for (size_t i = 0; i < joined.size(); i++) {
+            for (size_t j = 0; j < rows.size(); j++) {
+                matches.push_back({i, j});
+            }
         }
-
-        string line;
-        getline(file, line);
-
-        while (getline(file, line)) {
-            Vector<string> tableRow = Table::splitLine(line);
-            if (!tableRow.empty()) {
-                tableRow.erase(tableRow.begin());
+    } else
+    {
+        // Хеш-таблица строится по меньшей стороне, другая сторона её зондирует.
+        // Значения сравниваются как строки, как и в проверке условия соединения
+        const bool buildLeft = joined.size() < rows.size();
+        const Vector<Vector<string>>& build = buildLeft ? joined : rows;
+        const Vector<Vector<string>>& probe = buildLeft ? rows : joined;
+        const Vector<int>& buildKeys = buildLeft ? leftKeys : rightKeys;
+        const Vector<int>& probeKeys = buildLeft ? rightKeys : leftKeys;
+        auto keyOf = [](const Vector<string>& row, const Vector<int>& positions) {
+            string key;
+            for (const int position: positions) {
+                HashIndex::appendKeyPart(key, row[position]);
             }
-            Vector<string> newRow = currentRow;
-            newRow.insert(newRow.end(), tableRow.begin(), tableRow.end());
-
-            executeJoinRecursive(query, tableIndex + 1, newHeaders, newRow, result);
+            return key;
+        };
+        HashIndex table{Vector<string>(), Vector<int>()};
+        for (size_t i = 0; i < build.size(); i++) {
+            table.addKey(keyOf(build[i], buildKeys), static_cast<int>(i));
+        }
+        for (size_t i = 0; i < probe.size(); i++)
+        {
+            const Vector<int>* found = table.find(keyOf(probe[i], probeKeys));
+            if (found == nullptr) {
+                continue;
+            }
+            for (const int match: *found) {
+                matches.push_back(buildLeft ? make_pair(static_cast<size_t>(match), i) : make_pair(i, static_cast<size_t>(match)));
+            }
+        }
+        if (buildLeft) {
+            sort(matches.begin(), matches.end());
         }
-        file.close();
-        fileIndex++;
     }
+    Vector<Vector<string>> result;
+    result.reserve(matches.size());
+    for (const pair<size_t, size_t>& match: matches)
+    {
+        Vector<string> row;
+        row.reserve(joined[match.first].size() + rows[match.second].size());
+        for (const string& value: joined[match.first]) {
+            row.push_back(value);
+        }
+        for (const string& value: rows[match.second]) {
+            row.push_back(value);
+        }
+        result.push_back(move(row));
+    }
+    joined = move(result);
 }
 
 Vector<Vector<string>> Database::executeJoin(const SQLQuery& query)
@@ -172,12 +460,103 @@ Vector<Vector<string>> Database::executeJoin(const SQLQuery& query)
     }
     Vector<Vector<string>> result;
 
+    // Строки читаются прямо из резидентного кеша таблиц, все таблицы — в одном снимке базы.
+    // Защёлки держатся, только пока снимок закрепляет чанки таблицы
+    Vector<Table*> joinedTables;
+    Vector<Vector<string>> tableHeaders;
     Vector<string> allHeaders;
     for (const string& tableName: query.fromTables) {
         Table* table = getTable(tableName);
-        Vector<string> columns = table->getColumns();
-        for (const string& col: columns) {
-            allHeaders.push_back(tableName + "." + col);
+        joinedTables.push_back(table);
+        tableHeaders.push_back(table->getAllColumns(tableName));
+        for (const string& col: tableHeaders[tableHeaders.size() - 1]) {
+            allHeaders.push_back(col);
+        }
+    }
+    // WHERE делится на конъюнкты. Конъюнкт с колонками одной таблицы и литералами отбирает
+    // строки при чтении этой таблицы, сравнение её колонок между собой — сразу после чтения.
+    // Соединению остаются только конъюнкты, которые связывают таблицы
+    Vector<int> headerTables;
+    for (size_t t = 0; t < tableHeaders.size(); t++) {
+        for (size_t i = 0; i < tableHeaders[t].size(); i++) {
+            headerTables.push_back(static_cast<int>(t));
+        }
+    }
+    Vector<Condition*> conjuncts;
+    for (Condition* condition: query.whereConditions) {
+        splitConjuncts(condition, conjuncts);
+    }
+    Vector<Vector<Condition*>> scanConditions;
+    Vector<Vector<Condition*>> rowConditions;
+    scanConditions.resize(joinedTables.size(), Vector<Condition*>());
+    rowConditions.resize(joinedTables.size(), Vector<Condition*>());
+    Vector<Condition*> joinConditions;
+    Vector<Condition*> residual;
+    for (Condition* conjunct: conjuncts)
+    {
+        bool literal = true;
+        const int owner = conditionTable(*conjunct, allHeaders, headerTables, literal);
+        if (owner != -1 && literal) {
+            scanConditions[owner].push_back(conjunct);
+            continue;
+        }
+        if (owner != -1) {
+            rowConditions[owner].push_back(conjunct);
+        } else {
+            residual.push_back(conjunct);
+        }
+        joinConditions.push_back(conjunct);
+    }
+    // Таблица понимает список условий как OR, поэтому её конъюнкты сводятся в одно дерево AND
+    Vector<unique_ptr<Condition>> combined;
+    for (Vector<Condition*>& conditions: scanConditions)
+    {
+        for (size_t i = 1; i < conditions.size(); i++) {
+            combined.push_back(make_unique<Condition>("AND", conditions[0], conditions[i]));
+            conditions[0] = combined[combined.size() - 1].get();
+        }
+        conditions.resize(min(conditions.size(), static_cast<size_t>(1)), nullptr);
+    }
+
+    // Все таблицы читаются в одном снимке базы; строки каждой копируются один раз,
+    // по возрастанию PK, затем таблицы присоединяются слева направо
+    const ReadSnapshot snapshot(clock);
+    Vector<Vector<string>> joined;
+    Vector<string> joinedHeaders;
+    for (size_t t = 0; t < joinedTables.size(); t++)
+    {
+        Vector<Vector<string>> rows = joinedTables[t]->joinRows(snapshot.timestamp(), scanConditions[t],
+                                                                joinConditions, allHeaders);
+        if (!rowConditions[t].empty())
+        {
+            // Литералы привязаны к колонкам этой таблицы только что, в joinRows
+            const Predicate predicate = Predicate::compileJoined(rowConditions[t], tableHeaders[t]);
+            Vector<Vector<string>> kept;
+            Vector<string_view> cells;
+            for (Vector<string>& row: rows)
+            {
+                cells.clear();
+                for (const string& value: row) {
+                    cells.push_back(value);
+                }
+                if (predicate.matches(cells)) {
+                    kept.push_back(move(row));
+                }
+            }
+            rows = move(kept);
+        }
+        if (t == 0) {
+            joined = move(rows);
+        } else
+        {
+            Vector<int> leftKeys, rightKeys;
+            for (const Condition* condition: residual) {
+                collectJoinKeys(*condition, joinedHeaders, tableHeaders[t], leftKeys, rightKeys);
+            }
+            joinTable(joined, rows, leftKeys, rightKeys);
+        }
+        for (const string& header: tableHeaders[t]) {
+            joinedHeaders.push_back(header);
         }
     }
 
@@ -187,9 +566,46 @@ Vector<Vector<string>> Database::executeJoin(const SQLQuery& query)
     }
     result.push_back(selectedHeaders);
 
-    const Vector<string> emptyRow;
-    const Vector<string> emptyHeaders;
-    executeJoinRecursive(query, 0, emptyHeaders, emptyRow, result);
+    // Ключи соединения уже совпали; остальные условия проверяются на склеенной строке
+    Vector<int> selected;
+    for (const string& colName: query.selectColumns) {
+        selected.push_back(getColIndex(allHeaders, colName));
+    }
+    const Predicate predicate = Predicate::compileJoined(residual, allHeaders);
+    Vector<string_view> currentRow;
+    currentRow.reserve(allHeaders.size());
+    for (const Vector<string>& row: joined)
+    {
+        currentRow.clear();
+        for (const string& value: row) {
+            currentRow.push_back(value);
+        }
+        if (!predicate.matches(currentRow)) {
+            continue;
+        }
+        Vector<string> filteredRow;
+        for (const int colIdx: selected) {
+            if (colIdx != -1 && colIdx < row.size()) {
+                filteredRow.push_back(row[colIdx]);
+            }
+        }
+        result.push_back(move(filteredRow));
+    }
+
+    if (!query.orderColumn.empty())
+    {
+        const int orderIdx = getColIndex(selectedHeaders, query.orderColumn);
+        if (orderIdx == -1) {
+            throw runtime_error("ORDER BY для соединения требует колонку из списка SELECT: " + query.orderColumn);
+        }
+        const bool descending = query.orderDescending;
+        stable_sort(result.begin() + 1, result.end(), [orderIdx, descending](const Vector<string>& left, const Vector<string>& right) {
+            const string_view leftVal = orderIdx < left.size() ? string_view(left[orderIdx]) : string_view();
+            const string_view rightVal = orderIdx < right.size() ? string_view(right[orderIdx]) : string_view();
+            const int cmp = OrderedKey::compare(leftVal, rightVal);
+            return descending ? cmp > 0 : cmp < 0;
+        });
+    }
     return result;
 }
 
@@ -201,7 +617,8 @@ string Database::executeSelect(const SQLQuery& query) {
     Vector<Vector<string>> result;
     if (query.fromTables.size() == 1) {
         Table* table = getTable(query.fromTables[0]);
-        result = table->findData(query.selectColumns, query.whereConditions);
+        result = table->findData(query.selectColumns, query.whereConditions,
+                                 query.orderColumn, query.orderDescending);
     }
     else {
         result = executeJoin(query);
@@ -211,12 +628,50 @@ string Database::executeSelect(const SQLQuery& query) {
     return output;
 }
 
+string Database::executeShow(const SQLQuery& query) const
+{
+    if (query.showTarget == "LOCKS") {
+        return showLocks();
+    }
+    if (query.showTarget != "MEMORY") {
+        throw runtime_error("Неизвестный объект SHOW: " + query.showTarget);
+    }
+    Vector<Vector<string>> result;
+    result.push_back({"table", "rows", "bytes"});
+    size_t totalBytes = 0;
+    for (Table* table: getAllTables()) {
+        const size_t bytes = table->memoryUsage();
+        totalBytes += bytes;
+        result.push_back({table->getName(), to_string(table->rowCount()), to_string(bytes)});
+    }
+    result.push_back({"total", "", to_string(totalBytes)});
+    string output = printResult(result);
+    cout << output;
+    return output;
+}
+
+string Database::showLocks() const
+{
+    Vector<Vector<string>> result;
+    result.push_back({"table", "granted", "waited", "timeouts", "wait_ms", "max_wait_ms", "held", "waiting"});
+    for (Table* table: getAllTables()) {
+        const LockStats stats = table->lockStats();
+        result.push_back({table->getName(), to_string(stats.granted), to_string(stats.waited),
+                          to_string(stats.timeouts), to_string(stats.waitMicros / 1000),
+                          to_string(stats.maxWaitMicros / 1000), to_string(stats.held), to_string(stats.waiting)});
+    }
+    string output = printResult(result);
+    cout << output;
+    return output;
+}
+
 string Database::executeSQL(const string& sql)
 {
     SQLParser parser;
-    SQLQuery query = parser.parse(sql);
     try
     {
+        // Ошибка разбора, как и ошибка выполнения, возвращается клиенту
+        const SQLQuery query = parser.parse(sql);
         switch(query.type) {
         case SQLQuery::SELECT:
             return executeSelect(query);
@@ -224,6 +679,12 @@ string Database::executeSQL(const string& sql)
             return executeInsert(query);
         case SQLQuery::DELETE:
             return executeDelete(query);
+        case SQLQuery::UPDATE:
+            return executeUpdate(query);
+        case SQLQuery::COPY:
+            return executeCopy(query);
+        case SQLQuery::SHOW:
+            return executeShow(query);
         default:
             throw runtime_error("Неизвестный тип SQL запроса");
         }
@@ -4,38 +4,69 @@
 #include "parsing.h"
 #include "structures.h"
 #include "vector.h"
+#include <condition_variable>
+#include <thread>
 
 class Database {
 private:
     string name;
     string directory;
+    // Каталог, из которого COPY читает файлы; пустой — COPY запрещён
+    string importDirectory;
     int tuplesLimit;
+    double vacuumThreshold = 0.5;
+    int pkCache = 100;
+    int lockTimeoutMs = 5000;
+    int maintenanceIntervalMs = 1000;
+    int gcIntervalMs = 100;
     Hash tables;
     SQLParser parser;
-    static bool checkWhereJoined(const Vector<Condition*>& conditions, const Vector<string>& headers, const Vector<string>& row);
-    static bool checkConditionJoined(const Condition& condition, const Vector<string>& headers, const Vector<string>& row);
-    void executeJoinRecursive(
-        const SQLQuery& query,
-        size_t tableIndex,
-        const Vector<string>& currentHeaders,
-        const Vector<string>& currentRow,
-        Vector<Vector<string>>& result);
+    WriteAheadLog* wal = nullptr;
+    VersionClock clock;
+    thread maintenanceThread;
+    thread gcThread;
+    mutex maintenanceMutex;
+    condition_variable maintenanceWakeup;
+    bool stopping = false;
+    void maintenanceLoop();
+    void collectLoop();
+    void recover();
+    [[nodiscard]] Vector<Table*> getAllTables() const;
+    // Путь файла COPY внутри каталога импорта; абсолютные пути, '..' и выход по ссылкам отклоняются
+    [[nodiscard]] string resolveImportPath(const string& requested) const;
+    static void splitConjuncts(Condition* condition, Vector<Condition*>& conjuncts);
+    // Индекс таблицы соединения, к которой относятся все колонки условия, иначе -1.
+    // literal сбрасывается, если условие сравнивает колонки между собой
+    static int conditionTable(const Condition& condition, const Vector<string>& headers,
+                              const Vector<int>& headerTables, bool& literal);
+    static void collectJoinKeys(const Condition& condition, const Vector<string>& leftHeaders,
+                                const Vector<string>& rightHeaders, Vector<int>& leftKeys, Vector<int>& rightKeys);
+    static void joinTable(Vector<Vector<string>>& joined, const Vector<Vector<string>>& rows,
+                          const Vector<int>& leftKeys, const Vector<int>& rightKeys);
 
 public:
     Database()
     {
         loadSchema();
+        maintenanceThread = thread(&Database::maintenanceLoop, this);
+        gcThread = thread(&Database::collectLoop, this);
     };
 
     void loadSchema();
+    void checkpoint();
+    int collectGarbage();
     Table* getTable(const string& tableName) const;
     string executeInsert(const SQLQuery& query);
     string executeDelete(const SQLQuery& query);
+    string executeUpdate(const SQLQuery& query);
+    string executeCopy(const SQLQuery& query);
     string executeSelect(const SQLQuery& query);
+    string executeShow(const SQLQuery& query) const;
+    string showLocks() const;
     string executeSQL(const string& sql);
     static string printResult(const Vector<Vector<string>>& result);
     Vector<Vector<string>> executeJoin(const SQLQuery& query);
 
-    ~Database() = default;
+    ~Database();
 };
 #endif //DATABASE_H
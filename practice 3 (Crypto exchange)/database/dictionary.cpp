@@ -0,0 +1,76 @@
+#include "dictionary.h"
+
+uint32_t Dictionary::hash(const string_view value)
+{
+    uint32_t hash = 2166136261U;
+    for (const char c: value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+int Dictionary::find(const string_view value) const
+{
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = hash(value) & mask; slots[slot] != -1; slot = (slot + 1) & mask) {
+        if (this->value(slots[slot]) == value) {
+            return slots[slot];
+        }
+    }
+    return -1;
+}
+
+int Dictionary::encode(const string& value)
+{
+    const size_t mask = slots.size() - 1;
+    size_t slot = hash(value) & mask;
+    for (; slots[slot] != -1; slot = (slot + 1) & mask) {
+        if (this->value(slots[slot]) == value) {
+            return slots[slot];
+        }
+    }
+    if (count >= LIMIT) {
+        return -1;
+    }
+    const int code = count;
+    if (blocks[code / BLOCK] == nullptr) {
+        blocks[code / BLOCK] = new string[BLOCK];
+    }
+    blocks[code / BLOCK][code % BLOCK] = value;
+    count++;
+    slots[slot] = code;
+    // Заполненность не выше половины держит цепочки проб короткими
+    if (static_cast<size_t>(count) * 2 > slots.size()) {
+        grow();
+    }
+    return code;
+}
+
+void Dictionary::grow()
+{
+    Vector<int> bigger;
+    bigger.resize(slots.size() * 2, -1);
+    const size_t mask = bigger.size() - 1;
+    for (int code = 0; code < count; code++)
+    {
+        size_t slot = hash(value(code)) & mask;
+        while (bigger[slot] != -1) {
+            slot = (slot + 1) & mask;
+        }
+        bigger[slot] = static_cast<int>(code);
+    }
+    slots = move(bigger);
+}
+
+size_t Dictionary::memoryUsage() const
+{
+    size_t bytes = sizeof(Dictionary) + slots.size() * sizeof(int);
+    for (int code = 0; code < count; code++) {
+        bytes += value(code).capacity();
+    }
+    for (const string* block: blocks) {
+        bytes += block != nullptr ? BLOCK * sizeof(string) : 0;
+    }
+    return bytes;
+}
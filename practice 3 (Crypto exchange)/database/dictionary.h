@@ -0,0 +1,48 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+#include "vector.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Словарь колонки с небольшим числом различных значений: каждая строка хранится
+// один раз, чанки держат её код. Коды выдаются подряд и не переиспользуются,
+// поэтому общий для всей таблицы словарь позволяет сравнивать строки по кодам
+class Dictionary
+{
+public:
+    // Коды занимают 16 бит; заполненный словарь новых значений не принимает
+    static constexpr int LIMIT = 65535;
+private:
+    static constexpr int BLOCK = 256;
+    // Значения лежат блоками, которые не переезжают: снимки читают их без защёлки,
+    // пока писатель дописывает новые
+    string* blocks[(LIMIT + BLOCK - 1) / BLOCK] = {};
+    int count = 0;
+    // Открытая адресация: номер значения или -1
+    Vector<int> slots;
+    static uint32_t hash(string_view value);
+    void grow();
+public:
+    Dictionary() {slots.resize(64, -1);}
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+
+    // -1, если значения в словаре нет
+    [[nodiscard]] int find(string_view value) const;
+    // -1, если значения нет, а словарь заполнен
+    int encode(const string& value);
+    [[nodiscard]] const string& value(const int code) const {return blocks[code / BLOCK][code % BLOCK];}
+    [[nodiscard]] int size() const {return count;}
+    [[nodiscard]] size_t memoryUsage() const;
+
+    ~Dictionary()
+    {
+        for (const string* block: blocks) {
+            delete[] block;
+        }
+    }
+};
+
+#endif //DICTIONARY_H
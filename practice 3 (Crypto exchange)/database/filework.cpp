@@ -1,119 +1,710 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
 #include <fstream>
 #include <filesystem>
 #include <iostream>
+#include "mappedfile.h"
+#include "page.h"
 #include "table.h"
 using namespace std;
 using namespace filesystem;
 
-string Table::createNewFile()
+void Table::open()
 {
-    string cc = "1";
-    while (exists(path + "/" + cc + ".csv") == true)
+    createIndexes();
+    const auto start = chrono::steady_clock::now();
+    create_directories(path);
+    // Файл блокировки из прежних версий: блокировки теперь живут только в памяти
+    remove(path + "/" + tableName + "_lock");
+    if (owner == nullptr && exists(partitionLayoutPath())) {
+        throw runtime_error("Таблица '" + tableName + "' хранится в партициях, а схема не задаёт partition_by");
+    }
+    if (!exists(manifestPath()) && !exists(csvChunkPath(1)) && !exists(chunkPath(1))) {
+        createNewFile();
+        if (owner == nullptr) {
+            writePK();
+        }
+        writeManifest();
+        cout << "Table '" << tableName << "' created in " << path << endl;
+        return;
+    }
+    if (owner == nullptr) {
+        readPK();
+    }
+    readManifest();
+    // Чанки за последним из манифеста остались от прерванной загрузки COPY:
+    // их строки так и не были зафиксированы
+    for (int id = chunks.empty() ? 1 : chunks[chunks.size() - 1]->id + 1; exists(chunkPath(id)); id++)
     {
-        cc = to_string(stoi(cc) + 1);
+        removeChunkFiles(id);
+        remove(zonePath(id));
+        remove(deadMapPath(id));
+    }
+    if (options.format != "csv" && !chunks.empty() && exists(csvChunkPath(chunks[0]->id))) {
+        convertCsvChunks();
+        cout << "Table '" << tableName << "' converted to " << options.format << " format in " << path << endl;
+    } else {
+        loadRows();
+    }
+    const auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    cout << "Table '" << tableName << "' loaded from " << path
+         << " (" << rowCount() << " rows, " << memoryUsage() << " bytes, "
+         << options.format << ", " << elapsed.count() << " ms)" << endl;
+}
+
+Table::Table(Table& parent, const int partition)
+: tableName(parent.tableName), columns(parent.columns), path(parent.partitionPath(partition))
+, tuplesLimit(parent.tuplesLimit), options(parent.options)
+, locks(parent.tableName + "/p" + to_string(partition), parent.options.lockTimeoutMs), owner(&parent)
+{
+    options.partitionColumn.clear();
+    options.partitions = 1;
+    open();
+}
+
+// Каждая партиция — отдельный каталог pN со своими чанками, манифестом и индексами.
+// Последовательность ключей и раскладка (колонка и число партиций) лежат в каталоге таблицы
+void Table::openPartitions(const string& directory)
+{
+    partitionColumn = getColumnIndex(tableName + "." + options.partitionColumn);
+    if (partitionColumn <= 0) {
+        throw runtime_error("Партиции таблицы '" + tableName + "' заданы по неизвестной колонке: " + options.partitionColumn);
     }
-    string filename = path + "/" + cc + ".csv";
-    ofstream file(filename);
+    if (partitionColumn - 1 < options.types.size()) {
+        partitionType = options.types[partitionColumn - 1];
+    }
+    create_directories(path);
+    const string layoutLine = options.partitionColumn + " " + to_string(options.partitions);
+    const bool flat = exists(manifestPath()) || exists(csvChunkPath(1)) || exists(chunkPath(1));
+    const bool partitioned = exists(partitionLayoutPath());
+    if (partitioned)
+    {
+        ifstream file(partitionLayoutPath());
+        string stored;
+        getline(file, stored);
+        if (stored != layoutLine) {
+            throw runtime_error("Таблица '" + tableName + "' уже разбита на партиции (" + stored +
+                                "), а схема задаёт " + layoutLine);
+        }
+        rollbackCopy();
+    } else
+    {
+        // Перенос строк не был доведён до конца: партиции заполняются заново
+        for (int partition = 0; partition < options.partitions; partition++) {
+            remove_all(partitionPath(partition));
+        }
+    }
+    readPK();
+    for (int partition = 0; partition < options.partitions; partition++) {
+        partitions.push_back(new Table(*this, partition));
+    }
+    if (!partitioned)
+    {
+        if (flat) {
+            migrateToPartitions(directory);
+        }
+        replaceFile(partitionLayoutPath(), layoutLine + "\n");
+    }
+    if (flat) {
+        removeFlatFiles();
+    }
+    cout << "Table '" << tableName << "' partitioned by " << options.partitionColumn << " into "
+         << options.partitions << " partitions (" << rowCount() << " rows)" << endl;
+}
+
+// Строки таблицы без партиций раскладываются по партициям; старые файлы удаляются
+// только после записи раскладки, так что прерванный перенос просто повторится
+void Table::migrateToPartitions(const string& directory)
+{
+    TableOptions flatOptions = options;
+    flatOptions.partitionColumn.clear();
+    flatOptions.partitions = 1;
+    Table flat(tableName, columns, directory, tuplesLimit, flatOptions);
+    flat.forEachRow([this](const RowView& row) {
+        Vector<string> values = row.materialize();
+        const int key = parseKey(values[0]);
+        partitionFor(values)->appendRow(key, move(values), 0);
+        raisePK(key + 1);
+    });
+    for (Table* partition: partitions) {
+        partition->flushChunks();
+    }
+}
+
+void Table::removeFlatFiles() const
+{
+    Vector<string> stale;
+    for (const directory_entry& entry: directory_iterator(path)) {
+        const string filename = entry.path().string();
+        if (entry.is_regular_file() && filename != pkSequencePath() && filename != partitionLayoutPath()) {
+            stale.push_back(filename);
+        }
+    }
+    for (const string& filename: stale) {
+        remove(filename);
+    }
+}
+
+shared_ptr<ChunkInfo> Table::newChunk(const int id) const
+{
+    shared_ptr<ChunkInfo> chunk = make_shared<ChunkInfo>();
+    chunk->id = id;
+    chunk->reset(layout);
+    // Вместимость выделяется сразу: дописанные строки не сдвигают те, что читают снимки
+    chunk->reserve(tuplesLimit);
+    // Номер мог остаться от чанка, не попавшего в манифест (прерванная загрузка):
+    // его сводка и карта удалений к новому чанку не относятся
+    remove(zonePath(id));
+    remove(deadMapPath(id));
+    return chunk;
+}
+
+string Table::createNewFile()
+{
+    shared_ptr<ChunkInfo> chunk = newChunk(chunks.empty() ? 1 : chunks[chunks.size() - 1]->id + 1);
+    string filename = chunkPath(chunk->id);
     try
     {
+        chunk->bytes = writeChunkHeader(chunk->id);
+        cout << "Файл " << filename.substr(filename.rfind('/') + 1) << " создан успешно!\n";
+    } catch (const exception& e) {
+        cout << "Ошибка создания файла: " << e.what() << "\n";
+    }
+    chunks.push_back(move(chunk));
+    return filename;
+}
+
+Vector<string> Table::chunkFiles(const int id) const
+{
+    Vector<string> files;
+    if (isColumnar()) {
+        for (size_t column = 0; column < width(); column++) {
+            files.push_back(columnPath(id, column));
+        }
+    } else {
+        files.push_back(chunkPath(id));
+    }
+    return files;
+}
+
+size_t Table::writeChunkHeader(const int id, const string& suffix) const
+{
+    string header;
+    if (!isBinary() && !isColumnar())
+    {
+        header = tableName + "_pk";
+        for (const string& column : columns)
+        {
+            header += "," + tableName + "." + column;
+        }
+        header += "\n";
+    }
+    for (const string& filename: chunkFiles(id))
+    {
+        ofstream file(filename + suffix, ios::trunc | ios::binary);
         if (!file.is_open()) {
             throw runtime_error("Не удалось создать файл!");
         }
-        cout << "Файл " << cc << ".csv создан успешно!\n";
-        file << tableName << "_pk";
-        for (string column : columns)
+        file << header;
+    }
+    return header.size();
+}
+
+void Table::syncChunkFiles(const int id, const string& suffix) const
+{
+    for (const string& filename: chunkFiles(id)) {
+        WriteAheadLog::syncFile(filename + suffix);
+    }
+}
+
+void Table::removeChunkFiles(const int id) const
+{
+    for (const string& filename: chunkFiles(id)) {
+        remove(filename);
+    }
+}
+
+void Table::writeBulk(BulkLoad& load, const bool all)
+{
+    // Заполненные чанки пишутся по ходу загрузки, последний — когда файл прочитан до конца
+    const size_t ready = all || load.chunks.empty() ? load.chunks.size() : load.chunks.size() - 1;
+    for (; load.written < ready; load.written++)
+    {
+        ChunkInfo& chunk = *load.chunks[load.written];
+        chunk.bytes = writeChunkHeader(chunk.id);
+        chunk.bytes += writeDataToFile(chunk, 0, chunk.rowCount());
+        syncChunkFiles(chunk.id);
+        chunk.flushedRows = chunk.rowCount();
+        writeZoneMap(chunk);
+    }
+}
+
+void Table::discardBulk(const BulkLoad& load) const
+{
+    for (const shared_ptr<ChunkInfo>& chunk: load.chunks)
+    {
+        removeChunkFiles(chunk->id);
+        remove(zonePath(chunk->id));
+    }
+}
+
+void Table::rollbackCopy() const
+{
+    ifstream marker(copyMarkerPath());
+    if (!marker.is_open()) {
+        return;
+    }
+    int partition;
+    int firstId;
+    while (marker >> partition >> firstId)
+    {
+        // Чанки загрузки идут в конце манифеста. Их файлы удаляются здесь же: партиция
+        // с пустым манифестом иначе восстановила бы чанки по файлам
+        Vector<string> stale;
+        for (const directory_entry& entry: directory_iterator(partitionPath(partition)))
         {
-            file << "," << tableName << "." << column;
+            const string filename = entry.path().filename().string();
+            if (!filename.empty() && isdigit(static_cast<unsigned char>(filename[0])) && stoi(filename) >= firstId) {
+                stale.push_back(entry.path().string());
+            }
         }
-        file << endl;
-        file.close();
-    } catch (const exception& e) {
-        cout << "Ошибка создания файла: " << e.what() << "\n";
-        if (file.is_open()) {
-            file.close();
+        for (const string& filename: stale) {
+            remove(filename);
+        }
+        const string manifest = partitionPath(partition) + "/" + tableName + "_manifest";
+        ifstream file(manifest);
+        string kept;
+        string line;
+        while (getline(file, line)) {
+            if (!line.empty() && stoi(line) < firstId) {
+                kept += line + "\n";
+            }
         }
+        file.close();
+        replaceFile(manifest, kept);
     }
-    return filename;
+    marker.close();
+    remove(copyMarkerPath());
+    cout << "Table '" << tableName << "': незавершённая загрузка COPY отменена" << endl;
 }
 
-void Table::writePK()
+void Table::replaceFile(const string& filename, const string& contents)
 {
-    ofstream filePK(path + "/" + tableName + "_pk_sequence");
-    if (filePK.is_open())
     {
-        filePK << PK;
-        filePK.close();
+        ofstream file(filename + ".tmp", ios::trunc | ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        file << contents;
     }
+    WriteAheadLog::syncFile(filename + ".tmp");
+    rename(filename + ".tmp", filename);
+}
+
+void Table::writePK()
+{
+    replaceFile(pkSequencePath(), to_string(pkHighWater));
 }
 
 void Table::readPK()
 {
-    if (exists(path + "/" + tableName + "_pk_sequence") == true)
+    if (exists(pkSequencePath()) == true)
     {
-        ifstream filePK(path + "/" + tableName + "_pk_sequence");
+        ifstream filePK(pkSequencePath());
+        int highWater = 1;
         if (filePK.is_open())
         {
-            filePK >> PK;
+            filePK >> highWater;
             filePK.close();
         }
+        // После штатной остановки здесь точный следующий ключ, после сбоя — граница блока:
+        // ключи из него могли уйти в журнал и больше не выдаются
+        pkHighWater = highWater;
+        PK = highWater;
     } else
     {
-        PK = 1;
-        writePK();
+        resetPK();
     }
 }
 
+int Table::nextPK()
+{
+    return reserveKeys(1);
+}
 
-void Table::writeDataToFile(const string& filename, const Vector<string>& values)
+int Table::reserveKeys(const int count)
 {
-    ofstream file(filename, ios::app);
-    if (file.is_open()) {
-        file << PK;
-        for (const string& value: values) {
-            file << "," << value;
+    if (owner != nullptr) {
+        return owner->reserveKeys(count);
+    }
+    const int key = PK.fetch_add(count);
+    if (key + count > pkHighWater)
+    {
+        lock_guard<std::mutex> lock(pkMutex);
+        if (key + count > pkHighWater)
+        {
+            pkHighWater = key + count - 1 + options.pkCache;
+            writePK();
         }
-        file << endl;
-        file.close();
     }
+    return key;
 }
 
-bool Table::isTableBlocked() {
-    string lockFile = path + "/" + tableName + "_lock";
-    return exists(lockFile);
+void Table::releaseKeys(const int from, const int to)
+{
+    if (owner != nullptr) {
+        owner->releaseKeys(from, to);
+        return;
+    }
+    // Хвост возвращается, только если после блока ключей больше не выдавали
+    int expected = to;
+    PK.compare_exchange_strong(expected, from);
+}
+
+void Table::saveNextKey()
+{
+    if (owner != nullptr) {
+        return;
+    }
+    lock_guard<std::mutex> lock(pkMutex);
+    pkHighWater = PK.load();
+    writePK();
+}
+
+void Table::raisePK(const int next)
+{
+    if (owner != nullptr) {
+        owner->raisePK(next);
+        return;
+    }
+    int current = PK;
+    while (current < next && !PK.compare_exchange_weak(current, next)) {}
+}
+
+void Table::resetPK()
+{
+    // Последовательность общая для всех партиций и заводится у родительской таблицы
+    if (owner != nullptr) {
+        return;
+    }
+    lock_guard<std::mutex> lock(pkMutex);
+    PK = 1;
+    pkHighWater = 1;
+    writePK();
 }
 
-void Table::lockTable()
+// Подмена файлов чанка на версии с суффиксом .tmp. В колоночном формате файлов
+// несколько, поэтому сначала пишется маркер: с ним подмена доводится до конца при загрузке
+void Table::swapChunkFiles(const int id) const
 {
-    const string lockFile = path + "/" + tableName + "_lock";
+    {
+        ofstream marker(swapMarkerPath(id), ios::trunc);
+    }
+    WriteAheadLog::syncFile(swapMarkerPath(id));
+    finishChunkSwap(id);
+}
 
-    if (isTableBlocked()) {
-        throw runtime_error("Таблица '" + tableName + "' уже заблокирована!");
+void Table::finishChunkSwap(const int id) const
+{
+    for (const string& filename: chunkFiles(id)) {
+        if (exists(filename + ".tmp")) {
+            rename(filename + ".tmp", filename);
+        }
     }
+    remove(deadMapPath(id));
+    remove(swapMarkerPath(id));
+}
 
-    ofstream file(lockFile);
+void Table::recoverChunkSwap(const int id) const
+{
+    if (exists(swapMarkerPath(id))) {
+        finishChunkSwap(id);
+        return;
+    }
+    for (const string& filename: chunkFiles(id)) {
+        remove(filename + ".tmp");
+    }
+}
+
+size_t Table::writeDataToFile(const ChunkInfo& chunk, const size_t from, const size_t to, const string& suffix)
+{
+    if (isColumnar()) {
+        return writeColumnarRows(chunk, from, to, suffix);
+    }
+    if (isBinary()) {
+        return writeBinaryRows(chunkPath(chunk.id) + suffix, chunk, from, to);
+    }
+    string lines;
+    for (size_t i = from; i < to; i++)
+    {
+        for (size_t j = 0; j < chunk.columns.size(); j++) {
+            if (j > 0) {
+                lines += ",";
+            }
+            lines += chunk.value(j, i);
+        }
+        lines += "\n";
+    }
+    ofstream file(chunkPath(chunk.id) + suffix, ios::app);
     if (file.is_open()) {
-        file << "Table is locked!!!";
+        file << lines;
         file.close();
-        isLocked = true;
-        cout << "Таблица '" + tableName + "' заблокирована" << endl;
+        return lines.size();
+    }
+    return 0;
+}
+
+size_t Table::writeColumnarRows(const ChunkInfo& chunk, const size_t from, const size_t to, const string& suffix)
+{
+    // Сегмент колонки — подряд идущие значения: 4 байта длины (little-endian), затем байты
+    size_t written = 0;
+    string segment;
+    for (size_t column = 0; column < chunk.columns.size(); column++)
+    {
+        segment.clear();
+        for (size_t i = from; i < to; i++)
+        {
+            const string& value = chunk.value(column, i);
+            const uint32_t length = static_cast<uint32_t>(value.size());
+            for (int byte = 0; byte < 4; byte++) {
+                segment += static_cast<char>((length >> (8 * byte)) & 0xFF);
+            }
+            segment += value;
+        }
+        ofstream file(columnPath(chunk.id, column) + suffix, ios::app | ios::binary);
+        if (!file.is_open()) {
+            throw runtime_error("Не удалось открыть сегмент колонки таблицы '" + tableName + "'");
+        }
+        file.write(segment.data(), static_cast<streamsize>(segment.size()));
+        written += segment.size();
+    }
+    return written;
+}
+
+size_t Table::writeBinaryRows(const string& filename, const ChunkInfo& chunk,
+                              const size_t from, const size_t to)
+{
+    fstream file(filename, ios::in | ios::out | ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    file.seekg(0, ios::end);
+    const size_t oldSize = file.tellg();
+    string buffer(Page::SIZE, '\0');
+    Page page(buffer.data());
+    size_t pageOffset = oldSize;
+    if (oldSize >= Page::SIZE)
+    {
+        pageOffset = oldSize - Page::SIZE;
+        file.seekg(pageOffset);
+        file.read(buffer.data(), Page::SIZE);
     } else {
-        throw runtime_error("Не удалось заблокировать таблицу '" + tableName + "'");
+        page.init();
+    }
+    if (from == to) {
+        return 0;
+    }
+    for (size_t i = from; i < to; i++)
+    {
+        const Vector<string> row = RowView(chunk, static_cast<int>(i)).materialize();
+        if (page.append(row)) {
+            continue;
+        }
+        file.seekp(pageOffset);
+        file.write(buffer.data(), Page::SIZE);
+        pageOffset += Page::SIZE;
+        page.init();
+        if (!page.append(row)) {
+            throw runtime_error("Строка не помещается в страницу таблицы '" + tableName + "'");
+        }
+    }
+    file.seekp(pageOffset);
+    file.write(buffer.data(), Page::SIZE);
+    file.close();
+    return pageOffset + Page::SIZE - oldSize;
+}
+
+void Table::readCsvChunk(const string& filename, ChunkInfo& chunk)
+{
+    const MappedFile file(filename);
+    const string_view content = file.view();
+    Vector<string_view> fields;
+    size_t start = content.find('\n');
+    start = start == string_view::npos ? content.size() : start + 1;
+    while (start < content.size())
+    {
+        size_t end = content.find('\n', start);
+        if (end == string_view::npos) {
+            end = content.size();
+        }
+        splitLine(content.substr(start, end - start), fields);
+        Vector<string> row;
+        row.reserve(fields.size());
+        for (const string_view field: fields) {
+            row.push_back(string(field));
+        }
+        chunk.appendRow(move(row));
+        start = end + 1;
     }
+    chunk.bytes = content.size();
 }
 
-void Table::unlockTable()
+void Table::readBinaryChunk(const string& filename, ChunkInfo& chunk)
 {
-    const string lockFile = path + "/" + tableName + "_lock";
+    const MappedFile file(filename);
+    Vector<string_view> fields;
+    for (size_t offset = 0; offset + Page::SIZE <= file.size(); offset += Page::SIZE)
+    {
+        const Page page(file.data() + offset);
+        for (int slot = 0; slot < page.slotCount(); slot++)
+        {
+            page.record(slot, fields);
+            Vector<string> row;
+            row.reserve(fields.size());
+            for (const string_view field: fields) {
+                row.push_back(string(field));
+            }
+            chunk.appendRow(move(row));
+        }
+    }
+    chunk.bytes = file.size();
+}
 
-    if (!isTableBlocked()) {
-        throw runtime_error("Таблица '" + tableName + "' уже разблокирована!");
+bool Table::readColumnarChunk(ChunkInfo& chunk)
+{
+    chunk.bytes = 0;
+    size_t rows = SIZE_MAX;
+    for (size_t column = 0; column < width(); column++)
+    {
+        ColumnData& values = chunk.columns[column];
+        if (!exists(columnPath(chunk.id, column))) {
+            rows = 0;
+            continue;
+        }
+        const MappedFile file(columnPath(chunk.id, column));
+        const char* data = file.data();
+        size_t offset = 0;
+        while (offset + 4 <= file.size())
+        {
+            uint32_t length = 0;
+            for (int byte = 0; byte < 4; byte++) {
+                length |= static_cast<uint32_t>(static_cast<unsigned char>(data[offset + byte])) << (8 * byte);
+            }
+            if (offset + 4 + length > file.size()) {
+                break;
+            }
+            values.append(string(data + offset + 4, length));
+            offset += 4 + length;
+        }
+        chunk.bytes += file.size();
+        rows = min(rows, values.size());
     }
-    if (remove(lockFile))
+    // Сегменты колонок дописываются по очереди: после сбоя они могут разойтись по длине
+    bool consistent = true;
+    for (ColumnData& values: chunk.columns)
     {
-        isLocked = false;
-        cout << "Таблица '" + tableName + "' разблокирована" << endl;
-    } else
+        if (values.size() != rows) {
+            consistent = false;
+            values.truncate(rows);
+        }
+    }
+    chunk.rows = static_cast<int>(rows);
+    chunk.reserve(chunk.rows);
+    return consistent;
+}
+
+void Table::writeManifest()
+{
+    string manifest;
+    for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+        manifest += to_string(chunk->id) + " " + to_string(chunk->rowCount()) + " " + to_string(chunk->bytes) + "\n";
+    }
+    replaceFile(manifestPath(), manifest);
+}
+
+void Table::readManifest()
+{
+    chunks.clear();
+    ifstream fileManifest(manifestPath());
+    if (fileManifest.is_open())
     {
-        throw runtime_error("Не удалось разблокировать таблицу '" + tableName + "'");
+        int id;
+        int rowsInChunk;
+        size_t bytes;
+        while (fileManifest >> id >> rowsInChunk >> bytes) {
+            if (exists(chunkPath(id)) || exists(csvChunkPath(id))) {
+                shared_ptr<ChunkInfo> chunk = make_shared<ChunkInfo>();
+                chunk->id = id;
+                chunk->reset(layout);
+                chunk->bytes = bytes;
+                chunks.push_back(move(chunk));
+            }
+        }
+        fileManifest.close();
+    }
+    if (chunks.empty())
+    {
+        // Манифеста нет (таблица из старой версии) - восстанавливаем по файлам
+        for (int id = 1; exists(chunkPath(id)) || exists(csvChunkPath(id)); id++)
+        {
+            shared_ptr<ChunkInfo> chunk = make_shared<ChunkInfo>();
+            chunk->id = id;
+            chunk->reset(layout);
+            chunks.push_back(move(chunk));
+        }
+    }
+}
+
+void Table::writeDeadMap(const ChunkInfo& chunk)
+{
+    // На диск попадают и версии, которые ещё ждут сборщика: после перезапуска снимков нет
+    string bitmap((chunk.dead.size() + 7) / 8, '\0');
+    for (size_t slot = 0; slot < chunk.dead.size(); slot++) {
+        if (!chunk.isLive(slot)) {
+            bitmap[slot / 8] = static_cast<char>(bitmap[slot / 8] | (1 << (slot % 8)));
+        }
+    }
+    replaceFile(deadMapPath(chunk.id), bitmap);
+}
+
+void Table::readDeadMap(ChunkInfo& chunk)
+{
+    chunk.dead.clear();
+    chunk.dead.resize(chunk.rowCount(), false);
+    chunk.deadCount = 0;
+    ifstream file(deadMapPath(chunk.id), ios::binary);
+    if (!file.is_open()) {
+        return;
+    }
+    const string bitmap((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    for (size_t slot = 0; slot < chunk.dead.size() && slot / 8 < bitmap.size(); slot++) {
+        if (bitmap[slot / 8] & (1 << (slot % 8))) {
+            // Удалена до запуска: метка 1 старше любого снимка
+            chunk.dead[slot] = true;
+            chunk.expired[slot].store(1, memory_order_relaxed);
+            chunk.deadCount++;
+        }
     }
-}
\ No newline at end of file
+}
+
+void Table::writeZoneMap(const ChunkInfo& chunk) const
+{
+    // Сводка только ускоряет чтение: при несовпадении с чанком она строится заново
+    ofstream file(zonePath(chunk.id), ios::trunc | ios::binary);
+    if (file.is_open()) {
+        file << chunk.zone.serialize(chunk.deadCount);
+    }
+}
+
+bool Table::readZoneMap(ChunkInfo& chunk) const
+{
+    ifstream file(zonePath(chunk.id), ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    const string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return chunk.zone.deserialize(data)
+        && chunk.zone.rowCount() == chunk.rowCount()
+        && chunk.zone.hasLayout(static_cast<int>(columns.size()) + 1, bloomPositions);
+}
@@ -0,0 +1,127 @@
+#include "hashindex.h"
+
+int HashIndex::hashFunc(const string& key, const int capacity)
+{
+    unsigned int hash = 0;
+    for (const char c: key) {
+        hash = hash * 37 + static_cast<unsigned char>(c);
+    }
+    return static_cast<int>(hash % capacity);
+}
+
+void HashIndex::appendKeyPart(string& key, const string& value)
+{
+    // Длина перед значением не даёт составным ключам ("a,b" + "c" и "a" + "b,c") совпасть
+    key += to_string(value.size());
+    key += ':';
+    key += value;
+}
+
+void HashIndex::grow()
+{
+    const int newCapacity = capacity * 2;
+    auto** newCell = new IndexNode*[newCapacity];
+    for (int i = 0; i < newCapacity; i++) {
+        newCell[i] = nullptr;
+    }
+    for (int i = 0; i < capacity; i++)
+    {
+        IndexNode* current = cell[i];
+        while (current != nullptr)
+        {
+            IndexNode* next = current->next;
+            const int index = hashFunc(current->key, newCapacity);
+            current->next = newCell[index];
+            newCell[index] = current;
+            current = next;
+        }
+    }
+    delete[] cell;
+    cell = newCell;
+    capacity = newCapacity;
+}
+
+void HashIndex::addKey(string key, const int pk)
+{
+    const int index = hashFunc(key, capacity);
+    for (IndexNode* current = cell[index]; current != nullptr; current = current->next)
+    {
+        if (current->key == key) {
+            current->keys.push_back(pk);
+            return;
+        }
+    }
+    auto* node = new IndexNode(move(key), cell[index]);
+    node->keys.push_back(pk);
+    cell[index] = node;
+    size++;
+    if (size > capacity * 2) {
+        grow();
+    }
+}
+
+void HashIndex::removeKey(const string& key, const int pk)
+{
+    const int index = hashFunc(key, capacity);
+    IndexNode* prev = nullptr;
+    for (IndexNode* current = cell[index]; current != nullptr; prev = current, current = current->next)
+    {
+        if (current->key != key) {
+            continue;
+        }
+        for (int* it = current->keys.begin(); it != current->keys.end(); ++it) {
+            if (*it == pk) {
+                current->keys.erase(it);
+                break;
+            }
+        }
+        if (current->keys.empty())
+        {
+            if (prev != nullptr) {
+                prev->next = current->next;
+            } else {
+                cell[index] = current->next;
+            }
+            delete current;
+            size--;
+        }
+        return;
+    }
+}
+
+const Vector<int>* HashIndex::find(const string& key) const
+{
+    for (const IndexNode* current = cell[hashFunc(key, capacity)]; current != nullptr; current = current->next)
+    {
+        if (current->key == key) {
+            return &current->keys;
+        }
+    }
+    return nullptr;
+}
+
+void HashIndex::clear()
+{
+    for (int i = 0; i < capacity; i++)
+    {
+        const IndexNode* current = cell[i];
+        while (current != nullptr) {
+            const IndexNode* next = current->next;
+            delete current;
+            current = next;
+        }
+        cell[i] = nullptr;
+    }
+    size = 0;
+}
+
+size_t HashIndex::memoryUsage() const
+{
+    size_t bytes = sizeof(HashIndex) + capacity * sizeof(IndexNode*);
+    for (int i = 0; i < capacity; i++) {
+        for (const IndexNode* current = cell[i]; current != nullptr; current = current->next) {
+            bytes += sizeof(IndexNode) + current->key.capacity() + current->keys.size() * sizeof(int);
+        }
+    }
+    return bytes;
+}
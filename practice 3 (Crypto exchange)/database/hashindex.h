@@ -0,0 +1,74 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+#include "vector.h"
+#include <string>
+using namespace std;
+
+class IndexNode
+{
+private:
+    string key;
+    Vector<int> keys;
+    IndexNode* next;
+public:
+    IndexNode(string k, IndexNode* n) : key(move(k)), next(n) {}
+
+    friend class HashIndex;
+    ~IndexNode() = default;
+};
+
+// Вторичный хеш-индекс: значения индексируемых колонок строки -> список её PK.
+// Хранятся ключи, а не положения строк, поэтому очистка чанков индекс не трогает
+class HashIndex
+{
+private:
+    Vector<string> columnNames;
+    Vector<int> columns;
+    IndexNode** cell;
+    int capacity;
+    int size = 0;
+    static int hashFunc(const string& key, int capacity);
+    void grow();
+public:
+    HashIndex(const Vector<string>& names, const Vector<int>& positions) : columnNames(names), columns(positions), capacity(64)
+    {
+        cell = new IndexNode*[capacity];
+        for (int i = 0; i < capacity; i++) {
+            cell[i] = nullptr;
+        }
+    }
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+
+    static void appendKeyPart(string& key, const string& value);
+    // Row — любая строка с operator[] и size(): Vector<string> или RowView чанка
+    template<typename Row>
+    [[nodiscard]] string rowKey(const Row& row) const
+    {
+        string key;
+        for (const int column: columns) {
+            appendKeyPart(key, column < row.size() ? row[column] : string());
+        }
+        return key;
+    }
+    template<typename Row>
+    void add(const Row& row, const int pk) {addKey(rowKey(row), pk);}
+    template<typename Row>
+    void remove(const Row& row, const int pk) {removeKey(rowKey(row), pk);}
+    void addKey(string key, int pk);
+    void removeKey(const string& key, int pk);
+    [[nodiscard]] const Vector<int>* find(const string& key) const;
+    void clear();
+    [[nodiscard]] size_t memoryUsage() const;
+
+    [[nodiscard]] const Vector<string>& getColumnNames() const {return columnNames;}
+    [[nodiscard]] const Vector<int>& getColumns() const {return columns;}
+
+    ~HashIndex()
+    {
+        clear();
+        delete[] cell;
+    }
+};
+
+#endif //HASHINDEX_H
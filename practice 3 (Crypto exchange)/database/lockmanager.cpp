@@ -0,0 +1,209 @@
+#include "lockmanager.h"
+#include <chrono>
+#include <stdexcept>
+
+bool LockManager::compatible(const Mode held, const Mode requested)
+{
+    // IS совместима со всем, кроме X; IX — с намерениями; S — с S и IS; X — ни с чем
+    static constexpr bool matrix[4][4] = {
+        {true,  true,  true,  false},
+        {true,  true,  false, false},
+        {true,  false, true,  false},
+        {false, false, false, false},
+    };
+    return matrix[held][requested];
+}
+
+bool LockManager::covers(const Mode held, const Mode requested)
+{
+    if (held == requested || held == EXCLUSIVE) {
+        return true;
+    }
+    return requested == INTENT_SHARED;
+}
+
+LockManager::Entry* LockManager::entryFor(const int key, const bool create)
+{
+    Entry*& bucket = buckets[static_cast<unsigned int>(key) % BUCKETS];
+    for (Entry* entry = bucket; entry != nullptr; entry = entry->next) {
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    bucket = new Entry(key, bucket);
+    return bucket;
+}
+
+void LockManager::dropIfUnused(const int key)
+{
+    Entry** link = &buckets[static_cast<unsigned int>(key) % BUCKETS];
+    while (*link != nullptr && (*link)->key != key) {
+        link = &(*link)->next;
+    }
+    if (*link != nullptr && (*link)->head == nullptr) {
+        const Entry* entry = *link;
+        *link = entry->next;
+        delete entry;
+    }
+}
+
+bool LockManager::grantable(const Entry& entry, const Request& request) const
+{
+    bool ahead = true;
+    for (const Request* other = entry.head; other != nullptr; other = other->next)
+    {
+        if (other == &request) {
+            ahead = false;
+            continue;
+        }
+        if (other->owner == request.owner || compatible(other->mode, request.mode)) {
+            continue;
+        }
+        // Несовместимый ожидающий впереди тоже мешает: очередь не обгоняется
+        if (other->granted || ahead) {
+            return false;
+        }
+    }
+    return true;
+}
+
+string LockManager::describe(const int key)
+{
+    return key == TABLE ? "таблицы" : "строки " + to_string(key);
+}
+
+bool LockManager::acquire(const uint64_t owner, const int key, const Mode mode)
+{
+    unique_lock<mutex> lock(stateMutex);
+    Entry* entry = entryFor(key, true);
+    Request* request = nullptr;
+    Request* tail = nullptr;
+    for (Request* current = entry->head; current != nullptr; current = current->next)
+    {
+        if (current->owner == owner) {
+            request = current;
+        }
+        tail = current;
+    }
+    const bool upgrade = request != nullptr;
+    Mode wanted = mode;
+    if (upgrade)
+    {
+        if (covers(request->mode, mode)) {
+            return false;
+        }
+        // Усиление уже выданной блокировки: S + IX и подобные сочетания сводятся к X
+        wanted = covers(mode, request->mode) ? mode : EXCLUSIVE;
+    } else
+    {
+        request = new Request{owner, mode, false, nullptr};
+        if (tail != nullptr) {
+            tail->next = request;
+        } else {
+            entry->head = request;
+        }
+    }
+
+    const Mode previous = request->mode;
+    request->mode = wanted;
+    const auto start = chrono::steady_clock::now();
+    const auto deadline = start + chrono::milliseconds(timeoutMs);
+    bool waited = false;
+    while (!grantable(*entry, *request))
+    {
+        if (!waited) {
+            waited = true;
+            stats.waiting++;
+        }
+        if (changed.wait_until(lock, deadline) == cv_status::timeout && !grantable(*entry, *request))
+        {
+            stats.waiting--;
+            stats.timeouts++;
+            if (upgrade) {
+                request->mode = previous;
+            } else {
+                Request** link = &entry->head;
+                while (*link != request) {
+                    link = &(*link)->next;
+                }
+                *link = request->next;
+                delete request;
+                dropIfUnused(key);
+            }
+            changed.notify_all();
+            throw runtime_error("Истекло время ожидания блокировки " + describe(key) + " в таблице '" + name + "'");
+        }
+    }
+    if (waited)
+    {
+        stats.waiting--;
+        stats.waited++;
+        const uint64_t micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        stats.waitMicros += micros;
+        stats.maxWaitMicros = max(stats.maxWaitMicros, micros);
+    }
+    stats.granted++;
+    if (!upgrade) {
+        request->granted = true;
+        stats.held++;
+    }
+    return !upgrade;
+}
+
+void LockManager::release(const uint64_t owner, const int key)
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        Entry* entry = entryFor(key, false);
+        if (entry == nullptr) {
+            return;
+        }
+        for (Request** link = &entry->head; *link != nullptr; link = &(*link)->next)
+        {
+            if ((*link)->owner != owner) {
+                continue;
+            }
+            const Request* request = *link;
+            *link = request->next;
+            delete request;
+            stats.held--;
+            break;
+        }
+        dropIfUnused(key);
+    }
+    changed.notify_all();
+}
+
+LockStats LockManager::snapshot() const
+{
+    lock_guard<mutex> lock(stateMutex);
+    return stats;
+}
+
+LockManager::~LockManager()
+{
+    for (Entry*& bucket: buckets)
+    {
+        while (bucket != nullptr)
+        {
+            const Entry* entry = bucket;
+            bucket = entry->next;
+            for (const Request* request = entry->head; request != nullptr;) {
+                const Request* next = request->next;
+                delete request;
+                request = next;
+            }
+            delete entry;
+        }
+    }
+}
+
+void LockSet::lock(const int key, const LockManager::Mode mode)
+{
+    if (manager->acquire(owner, key, mode)) {
+        keys.push_back(key);
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef LOCKMANAGER_H
+#define LOCKMANAGER_H
+#include "vector.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+using namespace std;
+
+struct LockStats
+{
+    uint64_t granted = 0;
+    uint64_t waited = 0;
+    uint64_t timeouts = 0;
+    uint64_t waitMicros = 0;
+    uint64_t maxWaitMicros = 0;
+    int held = 0;
+    int waiting = 0;
+};
+
+// Логические блокировки таблицы и её строк (по PK) на время оператора.
+// Строки блокируются под намерением на таблицу (IS/IX), поэтому блокировка
+// всей таблицы (S/X) дожидается писателей отдельных строк и наоборот.
+// Ожидающие обслуживаются по очереди; взаимоблокировки разрываются таймаутом
+class LockManager
+{
+public:
+    enum Mode { INTENT_SHARED, INTENT_EXCLUSIVE, SHARED, EXCLUSIVE };
+    static constexpr int TABLE = -1;
+
+private:
+    struct Request
+    {
+        uint64_t owner;
+        Mode mode;
+        bool granted;
+        Request* next;
+    };
+    struct Entry
+    {
+        int key;
+        Request* head = nullptr;
+        Entry* next;
+        Entry(const int k, Entry* n) : key(k), next(n) {}
+    };
+    static constexpr int BUCKETS = 256;
+
+    string name;
+    int timeoutMs;
+    mutable mutex stateMutex;
+    condition_variable changed;
+    Entry* buckets[BUCKETS] = {};
+    atomic<uint64_t> nextOwner{1};
+    LockStats stats;
+
+    static bool compatible(Mode held, Mode requested);
+    static bool covers(Mode held, Mode requested);
+    Entry* entryFor(int key, bool create);
+    void dropIfUnused(int key);
+    [[nodiscard]] bool grantable(const Entry& entry, const Request& request) const;
+    static string describe(int key);
+
+public:
+    LockManager(string tableName, const int timeout) : name(move(tableName)), timeoutMs(timeout) {}
+    LockManager(const LockManager&) = delete;
+    LockManager& operator=(const LockManager&) = delete;
+
+    uint64_t newOwner() {return nextOwner++;}
+    // Ждёт не дольше таймаута, иначе бросает runtime_error.
+    // false — владелец уже держал блокировку этого ключа (возможно, более слабую)
+    bool acquire(uint64_t owner, int key, Mode mode);
+    void release(uint64_t owner, int key);
+    [[nodiscard]] LockStats snapshot() const;
+
+    ~LockManager();
+};
+
+// Блокировки одного оператора; снимаются разом в деструкторе
+class LockSet
+{
+private:
+    LockManager* manager;
+    uint64_t owner;
+    Vector<int> keys;
+public:
+    explicit LockSet(LockManager& locks) : manager(&locks), owner(locks.newOwner()) {}
+    LockSet(const LockSet&) = delete;
+    LockSet& operator=(const LockSet&) = delete;
+
+    void lockTable(const LockManager::Mode mode) {lock(LockManager::TABLE, mode);}
+    void lockRow(const int key, const LockManager::Mode mode) {lock(key, mode);}
+    void lock(int key, LockManager::Mode mode);
+
+    ~LockSet()
+    {
+        // Строки отпускаются раньше таблицы, обратным порядком
+        for (size_t i = keys.size(); i > 0; i--) {
+            manager->release(owner, keys[i - 1]);
+        }
+    }
+};
+
+#endif //LOCKMANAGER_H
@@ -0,0 +1,38 @@
+#include "mappedfile.h"
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const string& filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw runtime_error("Не удалось открыть файл " + filename);
+    }
+    struct stat info {};
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        throw runtime_error("Не удалось прочитать размер файла " + filename);
+    }
+    length = info.st_size;
+    if (length > 0)
+    {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("Не удалось отобразить файл " + filename);
+        }
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char*>(mapped);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes != nullptr) {
+        munmap(const_cast<char*>(bytes), length);
+    }
+}
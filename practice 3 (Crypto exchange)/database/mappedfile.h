@@ -0,0 +1,24 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Файл, отображённый в память только для чтения
+class MappedFile
+{
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+public:
+    explicit MappedFile(const string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] const char* data() const {return bytes;}
+    [[nodiscard]] size_t size() const {return length;}
+    [[nodiscard]] string_view view() const {return {bytes, length};}
+};
+
+#endif //MAPPEDFILE_H
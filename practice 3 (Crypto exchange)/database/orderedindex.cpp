@@ -0,0 +1,48 @@
+#include "orderedindex.h"
+#include <charconv>
+
+OrderedKey OrderedKey::parse(const string_view value)
+{
+    OrderedKey key;
+    double number = 0;
+    const char* end = value.data() + value.size();
+    const auto [ptr, error] = from_chars(value.data(), end, number);
+    if (!value.empty() && error == errc() && ptr == end) {
+        key.numeric = true;
+        key.number = number;
+    } else {
+        key.text = string(value);
+    }
+    return key;
+}
+
+int OrderedKey::compare(const OrderedKey& left, const OrderedKey& right)
+{
+    if (left.numeric != right.numeric) {
+        return left.numeric ? -1 : 1;
+    }
+    if (left.numeric) {
+        return left.number < right.number ? -1 : (left.number > right.number ? 1 : 0);
+    }
+    return left.text.compare(right.text);
+}
+
+int OrderedKey::compare(const string_view left, const string_view right)
+{
+    return compare(left, parse(right));
+}
+
+int OrderedKey::compare(const string_view left, const OrderedKey& right)
+{
+    double number = 0;
+    const char* end = left.data() + left.size();
+    const auto [ptr, error] = from_chars(left.data(), end, number);
+    const bool numeric = !left.empty() && error == errc() && ptr == end;
+    if (numeric != right.numeric) {
+        return numeric ? -1 : 1;
+    }
+    if (numeric) {
+        return number < right.number ? -1 : (number > right.number ? 1 : 0);
+    }
+    return left.compare(right.text);
+}
@@ -0,0 +1,118 @@
+#ifndef ORDEREDINDEX_H
+#define ORDEREDINDEX_H
+#include "bplustree.h"
+#include "vector.h"
+#include <climits>
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Типизированное значение колонки: числа сравниваются численно и идут раньше строк
+struct OrderedKey
+{
+    bool numeric = false;
+    double number = 0;
+    string text;
+
+    static OrderedKey parse(string_view value);
+    static int compare(const OrderedKey& left, const OrderedKey& right);
+    static int compare(string_view left, string_view right);
+    // Значение сравнивается с уже разобранным ключом без копирования строки
+    static int compare(string_view left, const OrderedKey& right);
+};
+
+struct OrderedEntry
+{
+    OrderedKey key;
+    int pk = 0;
+};
+
+struct OrderedEntryLess
+{
+    bool operator()(const OrderedEntry& left, const OrderedEntry& right) const
+    {
+        const int cmp = OrderedKey::compare(left.key, right.key);
+        return cmp != 0 ? cmp < 0 : left.pk < right.pk;
+    }
+};
+
+// Граница диапазона; set == false — диапазон открыт с этой стороны
+struct OrderedBound
+{
+    bool set = false;
+    bool inclusive = true;
+    OrderedKey key;
+};
+
+// Упорядоченный индекс по одной колонке: (значение, PK) в B+дереве
+class OrderedIndex
+{
+private:
+    string columnName;
+    int column;
+    BPlusTree<OrderedEntry, OrderedEntryLess> tree;
+    template<typename Row>
+    [[nodiscard]] OrderedEntry entryFor(const Row& row, const int pk) const
+    {
+        return {OrderedKey::parse(column < row.size() ? string_view(row[column]) : string_view()), pk};
+    }
+public:
+    OrderedIndex(string name, const int position) : columnName(move(name)), column(position) {}
+
+    template<typename Row>
+    void add(const Row& row, const int pk) {tree.insert(entryFor(row, pk));}
+    template<typename Row>
+    void remove(const Row& row, const int pk) {tree.erase(entryFor(row, pk));}
+    void clear() {tree.clear();}
+    [[nodiscard]] size_t memoryUsage() const {return tree.memoryUsage();}
+    [[nodiscard]] const string& getColumnName() const {return columnName;}
+    [[nodiscard]] int getColumn() const {return column;}
+
+    // Обходит PK в диапазоне [low, high] по возрастанию или убыванию значения;
+    // строки с равными значениями всегда идут по возрастанию PK. visit(pk, значение) возвращает false для остановки
+    template<typename Visitor>
+    void scan(const OrderedBound& low, const OrderedBound& high, const bool descending, Visitor&& visit) const
+    {
+        if (!descending)
+        {
+            auto cursor = low.set ? tree.lowerBound({low.key, low.inclusive ? INT_MIN : INT_MAX}) : tree.first();
+            for (; cursor.valid(); cursor.advance())
+            {
+                const OrderedEntry& entry = cursor.get();
+                if (high.set) {
+                    const int cmp = OrderedKey::compare(entry.key, high.key);
+                    if (cmp > 0 || (cmp == 0 && !high.inclusive)) {
+                        return;
+                    }
+                }
+                if (!visit(entry.pk, entry.key)) {
+                    return;
+                }
+            }
+            return;
+        }
+        auto cursor = high.set ? tree.before({high.key, high.inclusive ? INT_MAX : INT_MIN}) : tree.last();
+        Vector<int> group;
+        while (cursor.valid())
+        {
+            const OrderedKey& key = cursor.get().key;
+            if (low.set) {
+                const int cmp = OrderedKey::compare(key, low.key);
+                if (cmp < 0 || (cmp == 0 && !low.inclusive)) {
+                    return;
+                }
+            }
+            group.clear();
+            for (; cursor.valid() && OrderedKey::compare(cursor.get().key, key) == 0; cursor.retreat()) {
+                group.push_back(cursor.get().pk);
+            }
+            for (size_t i = group.size(); i > 0; i--) {
+                if (!visit(group[i - 1], key)) {
+                    return;
+                }
+            }
+        }
+    }
+};
+
+#endif //ORDEREDINDEX_H
@@ -0,0 +1,75 @@
+#include "page.h"
+#include <cstring>
+
+uint16_t Page::read16(const size_t offset) const
+{
+    uint16_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+void Page::write16(const size_t offset, const uint16_t value)
+{
+    memcpy(data + offset, &value, sizeof(value));
+}
+
+void Page::init()
+{
+    memset(data, 0, SIZE);
+    write16(0, 0);
+    write16(2, static_cast<uint16_t>(SIZE));
+}
+
+size_t Page::freeSpace() const
+{
+    const size_t slotsEnd = HEADER_SIZE + slotCount() * SLOT_SIZE;
+    const size_t recordsBegin = read16(2);
+    return recordsBegin - slotsEnd;
+}
+
+size_t Page::recordSize(const Vector<string>& values)
+{
+    size_t size = sizeof(uint16_t);
+    for (const string& value: values) {
+        size += sizeof(uint16_t) + value.size();
+    }
+    return size;
+}
+
+bool Page::append(const Vector<string>& values)
+{
+    const size_t size = recordSize(values);
+    if (size + SLOT_SIZE > freeSpace()) {
+        return false;
+    }
+    const size_t offset = read16(2) - size;
+    size_t pos = offset;
+    write16(pos, static_cast<uint16_t>(values.size()));
+    pos += sizeof(uint16_t);
+    for (const string& value: values) {
+        write16(pos, static_cast<uint16_t>(value.size()));
+        pos += sizeof(uint16_t);
+        memcpy(data + pos, value.data(), value.size());
+        pos += value.size();
+    }
+    const int slot = slotCount();
+    write16(HEADER_SIZE + slot * SLOT_SIZE, static_cast<uint16_t>(offset));
+    write16(HEADER_SIZE + slot * SLOT_SIZE + 2, static_cast<uint16_t>(size));
+    write16(0, static_cast<uint16_t>(slot + 1));
+    write16(2, static_cast<uint16_t>(offset));
+    return true;
+}
+
+void Page::record(const int slot, Vector<string_view>& fields) const
+{
+    fields.clear();
+    size_t pos = read16(HEADER_SIZE + slot * SLOT_SIZE);
+    const int fieldCount = read16(pos);
+    pos += sizeof(uint16_t);
+    for (int i = 0; i < fieldCount; i++) {
+        const uint16_t length = read16(pos);
+        pos += sizeof(uint16_t);
+        fields.push_back(string_view(data + pos, length));
+        pos += length;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef PAGE_H
+#define PAGE_H
+#include "vector.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Страница бинарного чанка: заголовок (число слотов, начало области записей),
+// за ним каталог слотов (смещение, длина), записи растут от конца страницы.
+// Запись: число полей, затем для каждого поля длина и байты.
+class Page
+{
+private:
+    char* data;
+    [[nodiscard]] uint16_t read16(size_t offset) const;
+    void write16(size_t offset, uint16_t value);
+public:
+    static constexpr size_t SIZE = 4096;
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t SLOT_SIZE = 4;
+
+    explicit Page(char* buffer) : data(buffer) {}
+    // Страница только для чтения (например, из отображённого файла)
+    explicit Page(const char* buffer) : data(const_cast<char*>(buffer)) {}
+
+    void init();
+    [[nodiscard]] int slotCount() const {return read16(0);}
+    [[nodiscard]] size_t freeSpace() const;
+    bool append(const Vector<string>& values);
+    void record(int slot, Vector<string_view>& fields) const;
+    static size_t recordSize(const Vector<string>& values);
+};
+
+#endif //PAGE_H
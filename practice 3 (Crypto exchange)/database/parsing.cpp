@@ -43,6 +43,10 @@ Vector<string> SQLParser::tokenize(const string& sql)
                         tokens.push_back(string(1, c));
                         curToken.clear();
                     }
+                    else
+                    {
+                        curToken += c;
+                    }
                     break;
                 }
             default:
@@ -80,6 +84,18 @@ SQLQuery SQLParser::parse(const string& sql)
         {
             return parseDelete(tokens);
         }
+    if (firstToken == "UPDATE")
+        {
+            return parseUpdate(tokens);
+        }
+    if (firstToken == "SHOW")
+        {
+            return parseShow(tokens);
+        }
+    if (firstToken == "COPY")
+        {
+            return parseCopy(sql, tokens);
+        }
     query.type = SQLQuery::UNKNOWN;
     return query;
 }
@@ -118,13 +134,26 @@ SQLQuery SQLParser::parseInsert(const Vector<string>& tokens)
             if (i + 1 >= tokens.size() || tokens[i + 1] != "(") {
                 throw runtime_error("Не хватает аргументов после VALUES");
             }
-            int startPos = i + 2;
-            for (int j = startPos; j < tokens.size(); j++) {
-                if (tokens[j] == ")") {
-                    break;
+            // Списки значений идут через запятую: VALUES (...), (...)
+            int j = i + 1;
+            while (j < tokens.size() && tokens[j] == "(")
+            {
+                Vector<string> values;
+                for (j++; j < tokens.size() && tokens[j] != ")"; j++) {
+                    if (tokens[j] != ",") {
+                        values.push_back(tokens[j]);
+                    }
+                }
+                if (j >= tokens.size()) {
+                    throw runtime_error("Список значений INSERT не закрыт скобкой");
+                }
+                if (values.empty()) {
+                    throw runtime_error("INSERT требует хотя бы одно значение");
                 }
-                if (tokens[j] != ",") {
-                    query.insertValues.push_back(tokens[j]);
+                query.insertRows.push_back(move(values));
+                j++;
+                if (j < tokens.size() && tokens[j] == ",") {
+                    j++;
                 }
             }
             break;
@@ -135,10 +164,6 @@ SQLQuery SQLParser::parseInsert(const Vector<string>& tokens)
         throw runtime_error("INSERT требует токен VALUES");
     }
 
-    if (query.insertValues.empty()) {
-        throw runtime_error("INSERT требует хотя бы одно значение");
-    }
-
     return query;
 }
 
@@ -197,6 +222,103 @@ SQLQuery SQLParser::parseDelete(const Vector<string>& tokens)
     return query;
 }
 
+SQLQuery SQLParser::parseUpdate(const Vector<string>& tokens)
+{
+    SQLQuery query;
+    query.type = SQLQuery::UPDATE;
+    if (tokens.size() < 2 || tokens[1] == "SET") {
+        throw runtime_error("UPDATE требует название таблицы");
+    }
+    query.updateTable = tokens[1];
+    if (tokens.size() < 3 || tokens[2] != "SET") {
+        throw runtime_error("UPDATE требует токен SET");
+    }
+
+    // Присваивания через запятую, до WHERE или конца запроса: колонка = значение
+    // или колонка = колонка + значение (и с минусом)
+    int i = 3;
+    while (i < tokens.size() && tokens[i] != "WHERE")
+    {
+        if (i + 2 >= tokens.size() || tokens[i + 1] != "=") {
+            throw runtime_error("SET ожидает присваивание вида колонка = значение");
+        }
+        Assignment assignment;
+        assignment.column = tokens[i];
+        if (i + 4 < tokens.size() && (tokens[i + 3] == "+" || tokens[i + 3] == "-"))
+        {
+            assignment.source = tokens[i + 2];
+            assignment.operation = tokens[i + 3][0];
+            assignment.value = tokens[i + 4];
+            i += 5;
+        } else
+        {
+            assignment.value = tokens[i + 2];
+            i += 3;
+        }
+        query.updateAssignments.push_back(move(assignment));
+        if (i < tokens.size() && tokens[i] == ",") {
+            i++;
+        }
+    }
+    if (query.updateAssignments.empty()) {
+        throw runtime_error("SET требует хотя бы одно присваивание");
+    }
+
+    if (i < tokens.size())
+    {
+        if (i + 1 >= tokens.size()) {
+            throw runtime_error("Не хватает условия WHERE");
+        }
+        query.updateConditions = parseWhere(tokens, i + 1);
+    }
+    return query;
+}
+
+SQLQuery SQLParser::parseShow(const Vector<string>& tokens)
+{
+    SQLQuery query;
+    query.type = SQLQuery::SHOW;
+    if (tokens.size() < 2)
+    {
+        throw runtime_error("SHOW требует объект (MEMORY или LOCKS)");
+    }
+    query.showTarget = tokens[1];
+    transform(query.showTarget.begin(), query.showTarget.end(), query.showTarget.begin(), ::toupper);
+    return query;
+}
+
+SQLQuery SQLParser::parseCopy(const string& sql, const Vector<string>& tokens)
+{
+    SQLQuery query;
+    query.type = SQLQuery::COPY;
+    if (tokens.size() < 4 || tokens[2] != "FROM")
+    {
+        throw runtime_error("COPY требует вид COPY <таблица> FROM '<путь>'");
+    }
+    query.copyTable = tokens[1];
+    // Путь берётся из исходной строки после COPY, имени таблицы и FROM:
+    // токенизатор режет его по пробелам и запятым
+    size_t start = sql.find_first_not_of(" \t\r\n") + tokens[0].size();
+    start = sql.find_first_not_of(" \t\r\n", start) + query.copyTable.size();
+    start = sql.find_first_not_of(" \t\r\n", start) + tokens[2].size();
+    start = sql.find_first_not_of(" \t\r\n", start);
+    size_t end = sql.find_last_not_of(" \t\r\n;");
+    if (start == string::npos || end == string::npos || end < start)
+    {
+        throw runtime_error("COPY требует путь к файлу после FROM");
+    }
+    if (end > start && (sql[start] == '\'' || sql[start] == '\"') && sql[end] == sql[start])
+    {
+        start++;
+        end--;
+    }
+    query.copyPath = sql.substr(start, end - start + 1);
+    if (query.copyPath.empty())
+    {
+        throw runtime_error("COPY требует путь к файлу после FROM");
+    }
+    return query;
+}
 
 Condition* SQLParser::parsePrimary(const Vector<string>& tokens, int& position)
 {
@@ -224,9 +346,9 @@ Condition* SQLParser::parsePrimary(const Vector<string>& tokens, int& position)
     string nameToken = tokens[position];
     string operToken = tokens[position + 1];
     string valueToken = tokens[position + 2];
-    if (operToken != "=")
+    if (operToken != "=" && operToken != "<" && operToken != "<=" && operToken != ">" && operToken != ">=")
     {
-        throw runtime_error("Поддерживается только оператор =");
+        throw runtime_error("Поддерживаются операторы =, <, <=, >, >=");
     }
     position += 3;
     return createCondition(nameToken, valueToken, operToken);
@@ -256,11 +378,44 @@ Condition* SQLParser::parseAND(const Vector<string>& tokens, int& position)
     return left;
 }
 
-SQLQuery SQLParser::parseSelect(const Vector<string>& tokens)
+SQLQuery SQLParser::parseSelect(const Vector<string>& allTokens)
 {
     SQLQuery query;
     query.type = SQLQuery::SELECT;
     bool findWHERE = false;
+
+    // ORDER BY <колонка> [ASC|DESC] стоит в конце запроса и отрезается до разбора WHERE
+    Vector<string> tokens;
+    int orderPos = -1;
+    for (int j = 0; j + 1 < allTokens.size(); j++) {
+        if (allTokens[j] == "ORDER" && allTokens[j + 1] == "BY") {
+            orderPos = j;
+            break;
+        }
+    }
+    for (int j = 0; j < (orderPos == -1 ? allTokens.size() : orderPos); j++) {
+        tokens.push_back(allTokens[j]);
+    }
+    if (orderPos != -1)
+    {
+        if (orderPos + 2 >= allTokens.size()) {
+            throw runtime_error("Не указана колонка после ORDER BY");
+        }
+        query.orderColumn = allTokens[orderPos + 2];
+        if (orderPos + 3 < allTokens.size())
+        {
+            string direction = allTokens[orderPos + 3];
+            transform(direction.begin(), direction.end(), direction.begin(), ::toupper);
+            if (direction != "ASC" && direction != "DESC") {
+                throw runtime_error("ORDER BY поддерживает только ASC или DESC");
+            }
+            query.orderDescending = direction == "DESC";
+        }
+        if (orderPos + 4 < allTokens.size()) {
+            throw runtime_error("Лишние токены после ORDER BY");
+        }
+    }
+
     int i = 1;
     for (; i < tokens.size(); i++)
     {
@@ -5,17 +5,29 @@
 #include "table.h"
 using namespace std;
 struct SQLQuery {
-    enum Type { SELECT, INSERT, DELETE, UNKNOWN } type;
+    enum Type { SELECT, INSERT, DELETE, UPDATE, SHOW, COPY, UNKNOWN } type;
 
     Vector<string> selectColumns;
     Vector<string> fromTables;
     Vector<Condition*> whereConditions;
+    string orderColumn;
+    bool orderDescending = false;
 
     string insertTable;
-    Vector<string> insertValues;
+    // Строки VALUES (...), (...) по порядку
+    Vector<Vector<string>> insertRows;
 
     string deleteTable;
     Vector<Condition*> deleteConditions;
+
+    string updateTable;
+    Vector<Assignment> updateAssignments;
+    Vector<Condition*> updateConditions;
+
+    string showTarget;
+
+    string copyTable;
+    string copyPath;
 };
 
 class SQLParser {
@@ -36,9 +48,12 @@ public:
 
     SQLQuery parse(const string& sql);
     static Vector<string> tokenize(const string& sql);
-    SQLQuery parseSelect(const Vector<string>& tokens);
+    SQLQuery parseSelect(const Vector<string>& allTokens);
     static SQLQuery parseInsert(const Vector<string>& tokens);
     SQLQuery parseDelete(const Vector<string>& tokens);
+    SQLQuery parseUpdate(const Vector<string>& tokens);
+    static SQLQuery parseShow(const Vector<string>& tokens);
+    static SQLQuery parseCopy(const string& sql, const Vector<string>& tokens);
 
     Vector<Condition*> parseWhere(const Vector<string>& tokens, int position);
     Condition* parsePrimary(const Vector<string>& tokens, int& position);
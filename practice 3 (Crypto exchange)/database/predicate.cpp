@@ -0,0 +1,329 @@
+#include "table.h"
+
+Predicate::Comparison Predicate::comparisonOf(const Condition& condition)
+{
+    const string& sign = condition.getSign();
+    if (sign == "<") return LESS;
+    if (sign == "<=") return LESS_EQUAL;
+    if (sign == ">") return GREATER;
+    if (sign == ">=") return GREATER_EQUAL;
+    return EQUAL;
+}
+
+bool Predicate::accepts(const Comparison comparison, const int cmp)
+{
+    switch (comparison)
+    {
+        case LESS: return cmp < 0;
+        case LESS_EQUAL: return cmp <= 0;
+        case GREATER: return cmp > 0;
+        case GREATER_EQUAL: return cmp >= 0;
+        default: return cmp == 0;
+    }
+}
+
+// Сжимает вектор выбора до слотов, прошедших test; порядок слотов сохраняется.
+// Запись без ветвления: слот пишется всегда, счётчик сдвигается только для подходящих
+template<typename Test>
+static void refine(Vector<int>& selection, Test&& test)
+{
+    int* slots = selection.begin();
+    const size_t count = selection.size();
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const int slot = slots[i];
+        slots[kept] = slot;
+        kept += test(slot) ? 1 : 0;
+    }
+    selection.resize(kept, 0);
+}
+
+// Оператор выбирается один раз на пачку, а не на каждый слот
+template<typename Value, typename Compare>
+static void refineBy(const Predicate::Comparison comparison, Vector<int>& selection, Value&& value, Compare&& compare)
+{
+    switch (comparison)
+    {
+        case Predicate::LESS:
+            refine(selection, [&](const int slot) {return compare(value(slot)) < 0;});
+            break;
+        case Predicate::LESS_EQUAL:
+            refine(selection, [&](const int slot) {return compare(value(slot)) <= 0;});
+            break;
+        case Predicate::GREATER:
+            refine(selection, [&](const int slot) {return compare(value(slot)) > 0;});
+            break;
+        case Predicate::GREATER_EQUAL:
+            refine(selection, [&](const int slot) {return compare(value(slot)) >= 0;});
+            break;
+        default:
+            refine(selection, [&](const int slot) {return compare(value(slot)) == 0;});
+    }
+}
+
+int Predicate::append(Node node)
+{
+    nodes.push_back(move(node));
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+template<typename Compile>
+void Predicate::compileList(const Vector<Condition*>& conditions, const Opcode opcode, Compile&& compile)
+{
+    if (conditions.empty()) {
+        append(Node(ALWAYS));
+        return;
+    }
+    // Список сворачивается вправо: c0 op (c1 op (c2 ...))
+    for (size_t i = 0; i + 1 < conditions.size(); i++)
+    {
+        const int parent = append(Node(opcode));
+        compile(*conditions[i]);
+        nodes[parent].operand = static_cast<int>(nodes.size());
+    }
+    compile(*conditions[conditions.size() - 1]);
+}
+
+Predicate Predicate::compile(const Vector<Condition*>& conditions, const Vector<ColumnData>& layout)
+{
+    Predicate predicate;
+    predicate.compileList(conditions, OR, [&](const Condition& condition) {
+        predicate.compileCondition(condition, layout);
+    });
+    return predicate;
+}
+
+Predicate Predicate::compileJoined(const Vector<Condition*>& conditions, const Vector<string>& headers)
+{
+    Predicate predicate;
+    predicate.compileList(conditions, AND, [&](const Condition& condition) {
+        predicate.compileJoinedCondition(condition, headers);
+    });
+    return predicate;
+}
+
+void Predicate::compileCondition(const Condition& condition, const Vector<ColumnData>& layout)
+{
+    const string& sign = condition.getSign();
+    if (sign == "AND" || sign == "OR")
+    {
+        if (!condition.getLeft() || !condition.getRight()) {
+            append(Node(NEVER));
+            return;
+        }
+        const int parent = append(Node(sign == "AND" ? AND : OR));
+        compileCondition(*condition.getLeft(), layout);
+        nodes[parent].operand = static_cast<int>(nodes.size());
+        compileCondition(*condition.getRight(), layout);
+        return;
+    }
+    const ConditionBinding& binding = condition.getBinding();
+    if ((sign != "=" && !condition.isRange()) || binding.column == -1 || static_cast<size_t>(binding.column) >= layout.size()) {
+        append(Node(NEVER));
+        return;
+    }
+    Node node;
+    node.comparison = comparisonOf(condition);
+    node.column = binding.column;
+    if (layout[binding.column].numeric())
+    {
+        node.opcode = NUMBER;
+        node.number = binding.number;
+    } else
+    {
+        node.opcode = binding.dictionary != nullptr ? CODE : TEXT;
+        node.number = binding.code;
+        node.dictionary = binding.dictionary;
+        node.text = binding.value;
+        node.key = OrderedKey::parse(binding.value);
+    }
+    append(move(node));
+}
+
+void Predicate::compileJoinedCondition(const Condition& condition, const Vector<string>& headers)
+{
+    const string& sign = condition.getSign();
+    if (sign == "AND" || sign == "OR")
+    {
+        if (!condition.getLeft() || !condition.getRight()) {
+            append(Node(NEVER));
+            return;
+        }
+        const int parent = append(Node(sign == "AND" ? AND : OR));
+        compileJoinedCondition(*condition.getLeft(), headers);
+        nodes[parent].operand = static_cast<int>(nodes.size());
+        compileJoinedCondition(*condition.getRight(), headers);
+        return;
+    }
+    if (sign != "=" && !condition.isRange()) {
+        append(Node(NEVER));
+        return;
+    }
+    int left = -1;
+    int right = -1;
+    for (int i = 0; i < static_cast<int>(headers.size()); i++)
+    {
+        if (left == -1 && headers[i] == condition.getName()) {
+            left = i;
+        }
+        if (right == -1 && headers[i] == condition.getValue()) {
+            right = i;
+        }
+    }
+    // Отсутствующая колонка слева равна только пустому значению, а диапазону не подходит
+    if (left == -1 && sign != "=") {
+        append(Node(NEVER));
+        return;
+    }
+    Node node;
+    node.comparison = comparisonOf(condition);
+    node.column = left;
+    if (right != -1)
+    {
+        node.opcode = CELLS;
+        node.operand = right;
+    } else
+    {
+        node.opcode = CELL;
+        node.text = condition.getBoundValue();
+        node.key = OrderedKey::parse(node.text);
+    }
+    append(move(node));
+}
+
+bool Predicate::evaluate(const int index, const RowView& row) const
+{
+    const Node& node = nodes[index];
+    switch (node.opcode)
+    {
+        case ALWAYS: return true;
+        case AND: return evaluate(index + 1, row) && evaluate(node.operand, row);
+        case OR: return evaluate(index + 1, row) || evaluate(node.operand, row);
+        default: break;
+    }
+    if (node.opcode == NEVER || static_cast<size_t>(node.column) >= row.size()) {
+        return false;
+    }
+    const ColumnData& column = row.column(node.column);
+    const int slot = row.getSlot();
+    if (node.opcode == NUMBER)
+    {
+        const int64_t value = column.number(slot);
+        return accepts(node.comparison, value < node.number ? -1 : value > node.number ? 1 : 0);
+    }
+    // Коды общего словаря совпадают тогда и только тогда, когда совпадают строки.
+    // Перекодированный в строки чанк сравнивается по тексту
+    if (node.opcode == CODE && column.dictionary == node.dictionary) {
+        return column.code(slot) == node.number;
+    }
+    if (node.comparison == EQUAL) {
+        return column.text(slot) == node.text;
+    }
+    return accepts(node.comparison, OrderedKey::compare(column.text(slot), node.key));
+}
+
+bool Predicate::evaluate(const int index, const Vector<string_view>& row) const
+{
+    const Node& node = nodes[index];
+    switch (node.opcode)
+    {
+        case ALWAYS: return true;
+        case AND: return evaluate(index + 1, row) && evaluate(node.operand, row);
+        case OR: return evaluate(index + 1, row) || evaluate(node.operand, row);
+        case CELL:
+        case CELLS: break;
+        default: return false;
+    }
+    const string_view left = node.column != -1 && static_cast<size_t>(node.column) < row.size() ? row[node.column] : string_view();
+    if (node.opcode == CELL)
+    {
+        if (node.comparison == EQUAL) {
+            return left == node.text;
+        }
+        return accepts(node.comparison, OrderedKey::compare(left, node.key));
+    }
+    const string_view right = static_cast<size_t>(node.operand) < row.size() ? row[node.operand] : string_view();
+    if (node.comparison == EQUAL) {
+        return left == right;
+    }
+    return accepts(node.comparison, OrderedKey::compare(left, right));
+}
+
+void Predicate::filter(const int index, const ChunkInfo& chunk, Vector<int>& selection) const
+{
+    const Node& node = nodes[index];
+    switch (node.opcode)
+    {
+        case ALWAYS:
+            return;
+        case AND:
+            filter(index + 1, chunk, selection);
+            if (!selection.empty()) {
+                filter(node.operand, chunk, selection);
+            }
+            return;
+        case OR:
+        {
+            // Правая ветвь проверяет только слоты, которые не прошли левую; результаты сливаются по возрастанию
+            Vector<int> left = selection;
+            filter(index + 1, chunk, left);
+            Vector<int> rest;
+            rest.reserve(selection.size() - left.size());
+            const int* taken = left.begin();
+            for (const int slot: selection)
+            {
+                if (taken != left.end() && *taken == slot) {
+                    taken++;
+                } else {
+                    rest.push_back(slot);
+                }
+            }
+            if (!rest.empty()) {
+                filter(node.operand, chunk, rest);
+            }
+            selection.clear();
+            const int* fromLeft = left.begin();
+            const int* fromRest = rest.begin();
+            while (fromLeft != left.end() || fromRest != rest.end())
+            {
+                if (fromRest == rest.end() || (fromLeft != left.end() && *fromLeft < *fromRest)) {
+                    selection.push_back(*fromLeft++);
+                } else {
+                    selection.push_back(*fromRest++);
+                }
+            }
+            return;
+        }
+        default:
+            break;
+    }
+    if (node.opcode == NEVER || static_cast<size_t>(node.column) >= chunk.columns.size())
+    {
+        selection.clear();
+        return;
+    }
+    const ColumnData& column = chunk.columns[node.column];
+    if (node.opcode == NUMBER)
+    {
+        const int64_t* numbers = column.numbers.begin();
+        const int64_t literal = node.number;
+        refineBy(node.comparison, selection, [numbers](const int slot) {return numbers[slot];},
+                 [literal](const int64_t value) {return value < literal ? -1 : value > literal ? 1 : 0;});
+        return;
+    }
+    if (node.opcode == CODE && column.dictionary == node.dictionary)
+    {
+        const uint16_t* codes = column.codes.begin();
+        const int64_t code = node.number;
+        refine(selection, [codes, code](const int slot) {return codes[slot] == code;});
+        return;
+    }
+    if (node.comparison == EQUAL)
+    {
+        refine(selection, [&](const int slot) {return column.text(slot) == node.text;});
+        return;
+    }
+    refineBy(node.comparison, selection, [&](const int slot) -> const string& {return column.text(slot);},
+             [&](const string& value) {return OrderedKey::compare(value, node.key);});
+}
@@ -11,6 +11,9 @@ class NodeHash{
 		NodeHash* prev;
 	public:
 		NodeHash(string  k, Table* d) : key(std::move(k)), data(d), next(nullptr), prev(nullptr) {}
+
+		Table* getData() const {return data;}
+		NodeHash* getNext() const {return next;}
 		
 		friend class Hash;
 		~NodeHash()= default;
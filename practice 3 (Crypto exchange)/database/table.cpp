@@ -1,230 +1,1561 @@
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 #include "table.h"
 using namespace filesystem;
 using namespace std;
 
-void Table::insertData(const Vector<string>& values)
+void Table::insertData(const Vector<Vector<string>>& rows)
 {
-    lockTable();
+    if (rows.empty()) {
+        return;
+    }
+    // Значения приводятся к записи своих типов до блокировки: ошибка не оставит таблицу занятой
+    const Vector<ColumnData>& types = partitions.empty() ? layout : partitions[0]->layout;
+    Vector<Vector<string>> prepared;
+    prepared.reserve(rows.size());
+    for (const Vector<string>& values: rows)
+    {
+        Vector<string> row;
+        row.push_back(string());
+        for (size_t column = 1; column < width(); column++)
+        {
+            const ColumnType& type = types[column].type;
+            if (column - 1 < values.size()) {
+                row.push_back(type.canonical(values[column - 1]));
+            } else {
+                row.push_back(type.isNumeric() ? type.format(0) : string());
+            }
+        }
+        prepared.push_back(move(row));
+    }
+    // Строки раскладываются по партициям; порядок целей — порядок партиций, как у DELETE
+    Vector<Table*> targets;
+    Vector<Vector<size_t>> members;
+    if (partitions.empty())
+    {
+        targets.push_back(this);
+        members.push_back(Vector<size_t>());
+        for (size_t i = 0; i < prepared.size(); i++) {
+            members[0].push_back(i);
+        }
+    } else
+    {
+        Vector<int> partitionOfRow;
+        for (const Vector<string>& row: prepared) {
+            partitionOfRow.push_back(partitionOf(row[partitionColumn]));
+        }
+        for (int partition = 0; partition < options.partitions; partition++)
+        {
+            Vector<size_t> rowsHere;
+            for (size_t i = 0; i < prepared.size(); i++) {
+                if (partitionOfRow[i] == partition) {
+                    rowsHere.push_back(i);
+                }
+            }
+            if (!rowsHere.empty()) {
+                targets.push_back(partitions[partition]);
+                members.push_back(move(rowsHere));
+            }
+        }
+    }
+    // Новые ключи ни с кем не пересекаются, достаточно намерения на таблицу
+    Vector<unique_ptr<LockSet>> statementLocks;
+    for (Table* target: targets)
+    {
+        statementLocks.push_back(make_unique<LockSet>(target->locks));
+        statementLocks[statementLocks.size() - 1]->lockTable(LockManager::INTENT_EXCLUSIVE);
+    }
+    uint64_t lsn = 0;
+    {
+        const shared_lock<shared_mutex> gate = wal ? wal->enter() : shared_lock<shared_mutex>();
+        Vector<unique_lock<shared_mutex>> latches;
+        for (Table* target: targets) {
+            latches.push_back(unique_lock<shared_mutex>(target->mutex));
+        }
+        // Ключи всех строк — один блок последовательности, в порядке VALUES
+        const int first = reserveKeys(static_cast<int>(prepared.size()));
+        for (size_t i = 0; i < prepared.size(); i++) {
+            prepared[i][0] = to_string(first + static_cast<int>(i));
+        }
+        // Вся вставка — одна запись журнала: строки подряд, по width() полей.
+        // Метку выдаёт журнал, снимки увидят строки, когда запись на диске
+        uint64_t stamp = 0;
+        if (wal)
+        {
+            Vector<string> fields;
+            fields.reserve(prepared.size() * width());
+            for (const Vector<string>& row: prepared) {
+                for (const string& value: row) {
+                    fields.push_back(value);
+                }
+            }
+            lsn = wal->append(WriteAheadLog::INSERT, tableName, fields, stamp);
+        } else {
+            stamp = clock->commit();
+        }
+        for (size_t t = 0; t < targets.size(); t++)
+        {
+            for (const size_t i: members[t]) {
+                targets[t]->appendRow(first + static_cast<int>(i), move(prepared[i]), stamp);
+            }
+            if (!wal) {
+                targets[t]->flushChunks();
+            }
+        }
+    }
+    if (wal) {
+        wal->waitDurable(lsn);
+    }
+}
+
+int Table::partitionOf(const string& value) const
+{
+    // FNV-1a от канонической записи: раскладка лежит на диске и не должна зависеть от std::hash
+    uint32_t hash = 2166136261U;
+    for (const char c: partitionType.canonical(value)) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+    return static_cast<int>(hash % options.partitions);
+}
+
+Table* Table::partitionFor(const Vector<string>& row) const
+{
+    return partitions[partitionOf(partitionColumn < row.size() ? row[partitionColumn] : string())];
+}
+
+void Table::collectPartitions(const Condition& condition, const Vector<string>* references, Vector<bool>& possible) const
+{
+    const string& sign = condition.getSign();
+    if ((sign == "AND" || sign == "OR") && condition.getLeft() && condition.getRight())
+    {
+        Vector<bool> left, right;
+        collectPartitions(*condition.getLeft(), references, left);
+        collectPartitions(*condition.getRight(), references, right);
+        possible.resize(options.partitions, false);
+        for (int partition = 0; partition < options.partitions; partition++) {
+            possible[partition] = sign == "AND" ? left[partition] && right[partition] : left[partition] || right[partition];
+        }
+        return;
+    }
+    possible.resize(options.partitions, true);
+    if (sign != "=" || getColumnIndex(condition.getName()) != partitionColumn) {
+        return;
+    }
+    if (references != nullptr) {
+        for (const string& reference: *references) {
+            if (reference == condition.getValue()) {
+                return;
+            }
+        }
+    }
+    // Литерал, не подходящий под тип колонки, отвергнет привязка условия в партиции
+    int64_t number = 0;
+    if (partitionType.isNumeric() && !partitionType.parseValue(condition.getValue(), number)) {
+        return;
+    }
+    const int target = partitionOf(condition.getValue());
+    for (int partition = 0; partition < options.partitions; partition++) {
+        possible[partition] = partition == target;
+    }
+}
+
+Vector<Table*> Table::targetsFor(const Vector<Condition*>& conditions, const Vector<string>* references)
+{
+    Vector<Table*> targets;
+    if (partitions.empty()) {
+        targets.push_back(this);
+        return targets;
+    }
+    // Условия списка объединены через OR: партиция нужна, если её допускает хоть одно
+    Vector<bool> needed;
+    needed.resize(options.partitions, conditions.empty());
+    for (const Condition* condition: conditions)
+    {
+        Vector<bool> possible;
+        collectPartitions(*condition, references, possible);
+        for (int partition = 0; partition < options.partitions; partition++) {
+            needed[partition] = needed[partition] || possible[partition];
+        }
+    }
+    for (int partition = 0; partition < options.partitions; partition++) {
+        if (needed[partition]) {
+            targets.push_back(partitions[partition]);
+        }
+    }
+    return targets;
+}
+
+void Table::appendRow(const int key, Vector<string>&& row, const uint64_t stamp, const Vector<string>* previous)
+{
+    if (chunks.empty() || chunks[chunks.size() - 1]->rowCount() >= tuplesLimit)
+    {
+        createNewFile();
+    }
+    // Хвост читают снимки без защёлки. Строку, которой не хватает выделенных массивов
+    // или которая заставит перекодировать колонку, получает копия хвоста
+    shared_ptr<ChunkInfo>& last = chunks[chunks.size() - 1];
+    if (last->rowCount() >= last->capacity || last->needsDecode(row)) {
+        last = last->clone(max(tuplesLimit, last->rowCount() + 1));
+    }
+    for (HashIndex* index: indexes) {
+        if (previous == nullptr || index->rowKey(*previous) != index->rowKey(row)) {
+            index->add(row, key);
+        }
+    }
+    for (OrderedIndex* index: orderedIndexes) {
+        const size_t column = index->getColumn();
+        if (previous == nullptr || (*previous)[column] != row[column]) {
+            index->add(row, key);
+        }
+    }
+    ChunkInfo& tail = *last;
+    if (!tail.zone.isInitialized()) {
+        initZone(tail);
+    }
+    tail.zone.add(row);
+    tail.appendRow(move(row), stamp);
+    indexRow(key, static_cast<int>(chunks.size()) - 1, tail.rowCount() - 1);
+}
+
+void Table::indexRow(const int key, const int chunk, const int slot)
+{
+    if (key <= 0) {
+        return;
+    }
+    if (key < highestKey) {
+        keysUnordered = true;
+    }
+    highestKey = max(highestKey, key);
+    while (static_cast<size_t>(key) >= pkIndex.size()) {
+        pkIndex.push_back(RowLocation());
+    }
+    pkIndex[key] = {chunk, slot};
+}
+
+RowLocation Table::locate(const int key) const
+{
+    if (key <= 0 || static_cast<size_t>(key) >= pkIndex.size()) {
+        return {};
+    }
+    return pkIndex[key];
+}
+
+void Table::markDead(const RowLocation& location)
+{
+    ChunkInfo& chunk = *chunks[location.chunk];
+    chunk.dead[location.slot] = true;
+    chunk.deadCount++;
+    chunk.pendingCount--;
+    const int key = parseKey(chunk.value(0, location.slot));
+    const RowLocation current = locate(key);
+    // Ключ уже ведёт к новой версии строки: записи индексов, которые у версий совпадают, принадлежат ей
+    const bool superseded = current.chunk != -1 && (current.chunk != location.chunk || current.slot != location.slot);
+    if (!superseded) {
+        pkIndex[key] = {};
+    } else if (supersededRows > 0) {
+        supersededRows--;
+    }
+    const RowView row(chunk, location.slot);
+    const RowView latest = superseded ? rowAt(current) : RowView();
+    for (HashIndex* index: indexes) {
+        if (!superseded || index->rowKey(row) != index->rowKey(latest)) {
+            index->remove(row, key);
+        }
+    }
+    for (OrderedIndex* index: orderedIndexes) {
+        const size_t column = index->getColumn();
+        if (!superseded || row[column] != latest[column]) {
+            index->remove(row, key);
+        }
+    }
+}
+
+int Table::collectGarbage(const uint64_t horizon)
+{
+    if (!partitions.empty())
+    {
+        int collected = 0;
+        for (Table* partition: partitions) {
+            collected += partition->collectGarbage(horizon);
+        }
+        return collected;
+    }
+    lock_guard<std::mutex> maintenance(maintenanceMutex);
+    {
+        shared_lock<shared_mutex> lock(mutex);
+        bool pending = false;
+        for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+            pending = pending || chunk->pendingCount > 0;
+        }
+        if (!pending) {
+            return 0;
+        }
+    }
     unique_lock<shared_mutex> lock(mutex);
+    int collected = 0;
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        ChunkInfo& chunk = *chunks[i];
+        for (int slot = 0; slot < chunk.rowCount() && chunk.pendingCount > 0; slot++)
+        {
+            const uint64_t stamp = chunk.expiredAt(slot);
+            if (stamp != 0 && stamp <= horizon && !chunk.isDead(slot)) {
+                markDead({i, slot});
+                collected++;
+            }
+        }
+    }
+    bool pending = false;
+    for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+        pending = pending || chunk->pendingCount > 0;
+    }
+    if (!pending) {
+        supersededRows = 0;
+    }
+    return collected;
+}
 
-    string cc = "1";
-    string lastExistingFile = "";
-    while (exists(path + "/" + cc + ".csv") == true)
+void Table::createIndexes()
+{
+    for (const IndexDefinition& definition: options.indexes)
+    {
+        Vector<int> positions;
+        Vector<string> columnNames;
+        for (const string& name: definition.columns)
+        {
+            const int position = getColumnIndex(tableName + "." + name);
+            if (position == -1) {
+                throw runtime_error("Индекс таблицы '" + tableName + "' ссылается на неизвестную колонку: " + name);
+            }
+            positions.push_back(position);
+            columnNames.push_back(tableName + "." + name);
+        }
+        if (positions.empty()) {
+            continue;
+        }
+        if (definition.type == "hash") {
+            indexes.push_back(new HashIndex(columnNames, positions));
+        } else if (definition.type == "btree" && positions.size() == 1) {
+            orderedIndexes.push_back(new OrderedIndex(columnNames[0], positions[0]));
+        } else if (definition.type == "btree") {
+            throw runtime_error("Упорядоченный индекс таблицы '" + tableName + "' строится по одной колонке");
+        } else {
+            throw runtime_error("Неизвестный тип индекса таблицы '" + tableName + "': " + definition.type);
+        }
+    }
+    for (const string& name: options.bloomColumns)
     {
-        lastExistingFile = path + "/" + cc + ".csv";
-        cc = to_string(stoi(cc) + 1);
+        const int position = getColumnIndex(tableName + "." + name);
+        if (position == -1) {
+            throw runtime_error("Bloom-фильтр таблицы '" + tableName + "' ссылается на неизвестную колонку: " + name);
+        }
+        bloomPositions.push_back(position);
+    }
+    layout.resize(width(), ColumnData());
+    for (size_t i = 0; i < options.types.size() && i < columns.size(); i++) {
+        layout[i + 1].type = options.types[i];
+    }
+    for (const string& name: options.dictionaryColumns)
+    {
+        const int position = getColumnIndex(tableName + "." + name);
+        if (position == -1) {
+            throw runtime_error("Словарь таблицы '" + tableName + "' ссылается на неизвестную колонку: " + name);
+        }
+        if (layout[position].numeric()) {
+            throw runtime_error("Словарь таблицы '" + tableName + "' задаётся только для колонок TEXT: " + name);
+        }
+        if (layout[position].dictionary == nullptr) {
+            layout[position].dictionary = new Dictionary();
+        }
+    }
+}
+
+void Table::initZone(ChunkInfo& chunk) const
+{
+    // Около 10 бит на строку дают порядка 1% ложных срабатываний при 4 хешах
+    chunk.zone.init(static_cast<int>(columns.size()) + 1, bloomPositions, max(64, tuplesLimit * 10));
+}
+
+void Table::rebuildZone(ChunkInfo& chunk) const
+{
+    initZone(chunk);
+    for (int slot = 0; slot < chunk.rowCount(); slot++) {
+        chunk.zone.add(RowView(chunk, slot));
+    }
+}
+
+bool Table::chunkMayMatch(const ChunkInfo& chunk, const Condition& condition, const Vector<string>* references) const
+{
+    const string& sign = condition.getSign();
+    if (sign == "AND" || sign == "OR")
+    {
+        if (!condition.getLeft() || !condition.getRight()) {
+            return true;
+        }
+        const bool left = chunkMayMatch(chunk, *condition.getLeft(), references);
+        if (sign == "AND" && !left) {
+            return false;
+        }
+        if (sign == "OR" && left) {
+            return true;
+        }
+        return chunkMayMatch(chunk, *condition.getRight(), references);
+    }
+    if (sign != "=" && !condition.isRange()) {
+        return true;
+    }
+    const int column = getColumnIndex(condition.getName());
+    if (column == -1) {
+        return true;
+    }
+    if (references != nullptr) {
+        for (const string& reference: *references) {
+            if (reference == condition.getValue()) {
+                return true;
+            }
+        }
+    }
+    if (sign == "=") {
+        // Значения нет в словаре — его нет ни в одном чанке, хранящем колонку кодами
+        const ConditionBinding& binding = condition.getBinding();
+        if (binding.dictionary != nullptr && binding.column == column && binding.code == -1 &&
+            chunk.columns[column].dictionary == binding.dictionary) {
+            return false;
+        }
+        return chunk.zone.mayEqual(column, condition.getBoundValue());
+    }
+    OrderedBound low, high;
+    OrderedBound& bound = (sign == ">" || sign == ">=") ? low : high;
+    bound = {true, sign == ">=" || sign == "<=", OrderedKey::parse(condition.getBoundValue())};
+    return chunk.zone.mayOverlap(column, low, high);
+}
+
+bool Table::chunkMayMatch(const ChunkInfo& chunk, const Vector<Condition*>& conditions,
+                          const Vector<string>* references) const
+{
+    if (chunk.deadCount == chunk.rowCount()) {
+        return false;
+    }
+    if (conditions.empty() || !chunk.zone.isInitialized()) {
+        return true;
+    }
+    for (const Condition* condition: conditions) {
+        if (chunkMayMatch(chunk, *condition, references)) {
+            return true;
+        }
     }
-    string currentFile = lastExistingFile;
-    if (currentFile.empty()) {
-        currentFile = createNewFile();
+    return false;
+}
+
+const OrderedIndex* Table::orderedIndexOn(const int column) const
+{
+    for (const OrderedIndex* index: orderedIndexes) {
+        if (index->getColumn() == column) {
+            return index;
+        }
     }
-    ifstream file(currentFile);
-    int lineCount = 0;
-    string line;
-    while (getline(file, line)) {
-        lineCount++;
+    return nullptr;
+}
+
+void Table::rebuildPkIndex()
+{
+    pkIndex.clear();
+    highestKey = 0;
+    keysUnordered = false;
+    for (int i = 0; i < chunks.size(); i++) {
+        for (int slot = 0; slot < chunks[i]->rowCount(); slot++) {
+            if (!chunks[i]->isDead(slot)) {
+                indexRow(parseKey(chunks[i]->value(0, slot)), i, slot);
+            }
+        }
+    }
+}
+
+void Table::rebuildIndexes()
+{
+    rebuildPkIndex();
+    for (HashIndex* index: indexes) {
+        index->clear();
+    }
+    for (OrderedIndex* index: orderedIndexes) {
+        index->clear();
+    }
+    if (indexes.empty() && orderedIndexes.empty()) {
+        return;
+    }
+    forEachRow([this](const RowView& row) {
+        const int key = parseKey(row[0]);
+        for (HashIndex* index: indexes) {
+            index->add(row, key);
+        }
+        for (OrderedIndex* index: orderedIndexes) {
+            index->add(row, key);
+        }
+    });
+}
+
+int Table::parseKey(const string& value)
+{
+    if (value.empty() || value.size() > 9) {
+        return -1;
+    }
+    int key = 0;
+    for (const char c: value) {
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        key = key * 10 + (c - '0');
+    }
+    return key;
+}
+
+void Table::collectComparisons(const Condition& condition, Vector<const Condition*>& comparisons)
+{
+    if (condition.getSign() == "=" || condition.isRange()) {
+        comparisons.push_back(&condition);
+    } else if (condition.getSign() == "AND" && condition.getLeft() && condition.getRight()) {
+        collectComparisons(*condition.getLeft(), comparisons);
+        collectComparisons(*condition.getRight(), comparisons);
+    }
+}
+
+bool Table::rangeFor(const OrderedIndex& index, const Vector<const Condition*>& comparisons,
+                     OrderedBound& low, OrderedBound& high)
+{
+    bool found = false;
+    for (const Condition* comparison: comparisons)
+    {
+        if (comparison->getName() != index.getColumnName()) {
+            continue;
+        }
+        const OrderedKey key = OrderedKey::parse(comparison->getBoundValue());
+        const string& sign = comparison->getSign();
+        // Из нескольких условий на колонку остаётся самая узкая граница
+        if (sign == "=" || sign == ">" || sign == ">=")
+        {
+            const bool inclusive = sign != ">";
+            const int cmp = low.set ? OrderedKey::compare(key, low.key) : 1;
+            if (cmp > 0 || (cmp == 0 && !inclusive)) {
+                low = {true, inclusive, key};
+            }
+        }
+        if (sign == "=" || sign == "<" || sign == "<=")
+        {
+            const bool inclusive = sign != "<";
+            const int cmp = high.set ? OrderedKey::compare(key, high.key) : -1;
+            if (cmp < 0 || (cmp == 0 && !inclusive)) {
+                high = {true, inclusive, key};
+            }
+        }
+        found = true;
+    }
+    return found;
+}
+
+bool Table::collectKeys(const Condition& condition, Vector<int>& keys, const bool useOrdered) const
+{
+    if (condition.getSign() == "OR")
+    {
+        if (!condition.getLeft() || !condition.getRight()) {
+            return false;
+        }
+        return collectKeys(*condition.getLeft(), keys, useOrdered) && collectKeys(*condition.getRight(), keys, useOrdered);
+    }
+    // Кандидаты берутся по одному индексу, остальные условия AND проверит скомпилированный предикат
+    Vector<const Condition*> comparisons;
+    collectComparisons(condition, comparisons);
+    for (const Condition* comparison: comparisons)
+    {
+        if (comparison->getSign() == "=" && getColumnIndex(comparison->getName()) == 0)
+        {
+            const int key = parseKey(comparison->getBoundValue());
+            if (key >= 0) {
+                keys.push_back(key);
+                return true;
+            }
+        }
+    }
+    for (const HashIndex* index: indexes)
+    {
+        string indexKey;
+        bool covered = true;
+        for (const string& column: index->getColumnNames())
+        {
+            const Condition* match = nullptr;
+            for (const Condition* comparison: comparisons) {
+                if (comparison->getSign() == "=" && comparison->getName() == column) {
+                    match = comparison;
+                    break;
+                }
+            }
+            if (match == nullptr) {
+                covered = false;
+                break;
+            }
+            HashIndex::appendKeyPart(indexKey, match->getBoundValue());
+        }
+        if (covered)
+        {
+            if (const Vector<int>* found = index->find(indexKey)) {
+                for (const int key: *found) {
+                    keys.push_back(key);
+                }
+            }
+            return true;
+        }
+    }
+    if (!useOrdered) {
+        return false;
+    }
+    for (const OrderedIndex* index: orderedIndexes)
+    {
+        OrderedBound low, high;
+        if (rangeFor(*index, comparisons, low, high))
+        {
+            index->scan(low, high, false, [&keys](const int key, const OrderedKey&) {
+                keys.push_back(key);
+                return true;
+            });
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Table::lookupKeys(const Vector<Condition*>& conditions, Vector<int>& keys, const bool useOrdered) const
+{
+    if (conditions.empty()) {
+        return false;
+    }
+    for (const Condition* condition: conditions) {
+        if (!collectKeys(*condition, keys, useOrdered)) {
+            return false;
+        }
+    }
+    // Ключи растут в порядке вставки, так что сортировка сохраняет порядок полного обхода
+    sort(keys.begin(), keys.end());
+    size_t unique = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (unique == 0 || keys[unique - 1] != keys[i]) {
+            keys[unique++] = keys[i];
+        }
+    }
+    keys.resize(unique, 0);
+    return true;
+}
+
+void Table::flush()
+{
+    // Во время контрольной точки писатели стоят у журнала, а снимки не читают
+    // служебные поля чанков, поэтому файлы пишутся под разделяемой защёлкой
+    for (Table* partition: partitions) {
+        partition->flush();
+    }
+    if (!partitions.empty()) {
+        return;
+    }
+    shared_lock<shared_mutex> lock(mutex);
+    flushChunks();
+}
+
+void Table::flushChunks()
+{
+    for (const shared_ptr<ChunkInfo>& pointer: chunks)
+    {
+        ChunkInfo& chunk = *pointer;
+        const bool changed = chunk.flushedRows < chunk.rowCount() || chunk.deadDirty;
+        if (chunk.flushedRows < chunk.rowCount())
+        {
+            chunk.bytes += writeDataToFile(chunk, chunk.flushedRows, chunk.rowCount());
+            chunk.flushedRows = chunk.rowCount();
+            syncChunkFiles(chunk.id);
+        }
+        if (chunk.deadDirty)
+        {
+            writeDeadMap(chunk);
+            chunk.deadDirty = false;
+        }
+        if (changed) {
+            writeZoneMap(chunk);
+        }
+    }
+    writeManifest();
+}
+
+void Table::replayInsert(const Vector<string>& fields)
+{
+    // Запись многострочной вставки — строки подряд, по width() полей
+    for (size_t offset = 0; offset + width() <= fields.size(); offset += width())
+    {
+        Vector<string> row;
+        row.reserve(width());
+        for (size_t column = 0; column < width(); column++) {
+            row.push_back(fields[offset + column]);
+        }
+        replayRow(row);
+    }
+}
+
+void Table::replayRow(const Vector<string>& row)
+{
+    if (!partitions.empty()) {
+        partitionFor(row)->replayRow(row);
+        return;
+    }
+    unique_lock<shared_mutex> lock(mutex);
+    const int key = parseKey(row[0]);
+    if (locate(key).chunk == -1) {
+        appendRow(key, Vector<string>(row), clock->commit());
+    }
+    raisePK(key + 1);
+}
+
+void Table::replayDelete(const Vector<string>& keys)
+{
+    // В записи журнала только ключи: каждая партиция удаляет те, что нашлись у неё
+    for (Table* partition: partitions) {
+        partition->replayDelete(keys);
+    }
+    if (!partitions.empty()) {
+        return;
+    }
+    unique_lock<shared_mutex> lock(mutex);
+    // Снимков при восстановлении нет, так что удалённая версия сразу собирается
+    for (const string& key: keys)
+    {
+        const RowLocation location = locate(parseKey(key));
+        if (location.chunk != -1 && chunks[location.chunk]->isLive(location.slot)) {
+            chunks[location.chunk]->expire(location.slot, clock->commit());
+            markDead(location);
+        }
+    }
+}
+
+void Table::replayUpdate(const Vector<string>& fields)
+{
+    // Прежняя версия ищется по ключу во всех партициях: строка могла переехать
+    for (size_t offset = 0; offset + width() <= fields.size(); offset += width())
+    {
+        Vector<string> row;
+        row.reserve(width());
+        for (size_t column = 0; column < width(); column++) {
+            row.push_back(fields[offset + column]);
+        }
+        const int key = parseKey(row[0]);
+        for (Table* table: partitions.empty() ? Vector<Table*>{this} : partitions)
+        {
+            unique_lock<shared_mutex> lock(table->mutex);
+            const RowLocation location = table->locate(key);
+            if (location.chunk != -1 && table->chunks[location.chunk]->isLive(location.slot)) {
+                table->chunks[location.chunk]->expire(location.slot, clock->commit());
+                table->markDead(location);
+            }
+        }
+        replayRow(row);
+    }
+}
+
+Vector<string> Table::splitLine(const string& line)
+{
+    Vector<string> splitted;
+    stringstream ss(line);
+    string token;
+    while (getline(ss, token, ',')) {
+        splitted.push_back(token);
+    }
+    return splitted;
+}
+
+void Table::splitLine(const string_view line, Vector<string_view>& fields)
+{
+    fields.clear();
+    size_t start = 0;
+    while (start < line.size())
+    {
+        size_t end = line.find(',', start);
+        if (end == string_view::npos) {
+            end = line.size();
+        }
+        fields.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+void Table::loadRows()
+{
+    bool manifestChanged = false;
+    for (shared_ptr<ChunkInfo>& pointer: chunks)
+    {
+        ChunkInfo& chunk = *pointer;
+        const size_t expectedBytes = chunk.bytes;
+        recoverChunkSwap(chunk.id);
+        chunk.reset(layout);
+        chunk.bytes = 0;
+        bool consistent = true;
+        if (isColumnar()) {
+            consistent = readColumnarChunk(chunk);
+        } else if (isBinary()) {
+            readBinaryChunk(chunkPath(chunk.id), chunk);
+        } else {
+            readCsvChunk(chunkPath(chunk.id), chunk);
+        }
+        readDeadMap(chunk);
+        chunk.flushedRows = chunk.rowCount();
+        if (!consistent) {
+            pointer = rewriteChunk(chunk);
+        } else if (!readZoneMap(chunk)) {
+            rebuildZone(chunk);
+            writeZoneMap(chunk);
+        }
+        for (int slot = 0; slot < pointer->rowCount(); slot++) {
+            raisePK(parseKey(pointer->value(0, slot)) + 1);
+        }
+        manifestChanged = manifestChanged || pointer->bytes != expectedBytes;
+    }
+    rebuildIndexes();
+    if (manifestChanged) {
+        writeManifest();
+    }
+}
+
+void Table::convertCsvChunks()
+{
+    for (const shared_ptr<ChunkInfo>& pointer: chunks)
+    {
+        ChunkInfo& chunk = *pointer;
+        chunk.reset(layout);
+        readCsvChunk(csvChunkPath(chunk.id), chunk);
+        readDeadMap(chunk);
+        writeChunkHeader(chunk.id);
+        chunk.bytes = writeDataToFile(chunk, 0, chunk.rowCount());
+        chunk.flushedRows = chunk.rowCount();
+        rebuildZone(chunk);
+        writeZoneMap(chunk);
+        remove(csvChunkPath(chunk.id));
+    }
+    rebuildIndexes();
+    writeManifest();
+}
+
+Vector<Vector<string>> Table::selectAll()
+{
+    Vector<Vector<string>> allData;
+    allData.push_back(getAllColumns(tableName));
+    forEachRow([&allData](const RowView& row) {
+        allData.push_back(row.materialize());
+    });
+    return allData;
+}
+
+// Копия чанка без удалённых строк; старый объект остаётся у снимков, которые его закрепили
+shared_ptr<ChunkInfo> Table::rewriteChunk(const ChunkInfo& chunk)
+{
+    shared_ptr<ChunkInfo> live = make_shared<ChunkInfo>();
+    live->id = chunk.id;
+    live->reset(layout);
+    for (int slot = 0; slot < chunk.rowCount(); slot++)
+    {
+        if (!chunk.isLive(slot)) {
+            continue;
+        }
+        live->appendRow(RowView(chunk, slot).materialize(), chunk.created[slot]);
+    }
+    // Новые файлы пишутся рядом и подменяют старые после записи маркера
+    const size_t headerBytes = writeChunkHeader(chunk.id, ".tmp");
+    live->bytes = headerBytes + writeDataToFile(*live, 0, live->rowCount(), ".tmp");
+    syncChunkFiles(chunk.id, ".tmp");
+    swapChunkFiles(chunk.id);
+    live->flushedRows = live->rowCount();
+    rebuildZone(*live);
+    writeZoneMap(*live);
+    return live;
+}
+
+int Table::vacuum()
+{
+    if (!partitions.empty())
+    {
+        int rewritten = 0;
+        for (Table* partition: partitions) {
+            rewritten += partition->vacuum();
+        }
+        return rewritten;
+    }
+    lock_guard<std::mutex> maintenance(maintenanceMutex);
+    // Копии пишутся под разделяемой защёлкой: писатели во время контрольной точки
+    // стоят у журнала, а читатели ждут только подмены списка чанков
+    Vector<shared_ptr<ChunkInfo>> replaced;
+    Vector<int> removed;
+    {
+        shared_lock<shared_mutex> lock(mutex);
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            const ChunkInfo& chunk = *chunks[i];
+            const bool isTail = i + 1 == chunks.size();
+            // Версии, которые ещё могут понадобиться снимкам, сначала собирает сборщик
+            if (chunk.deadCount == 0 || chunk.pendingCount > 0 ||
+                chunk.deadCount < options.vacuumThreshold * chunk.rowCount())
+            {
+                continue;
+            }
+            if (chunk.deadCount == chunk.rowCount() && !isTail)
+            {
+                removeChunkFiles(chunk.id);
+                remove(deadMapPath(chunk.id));
+                remove(zonePath(chunk.id));
+                removed.push_back(chunk.id);
+                continue;
+            }
+            replaced.push_back(rewriteChunk(chunk));
+        }
+    }
+    const int rewritten = static_cast<int>(replaced.size() + removed.size());
+    if (rewritten == 0) {
+        return 0;
+    }
+    unique_lock<shared_mutex> lock(mutex);
+    Vector<shared_ptr<ChunkInfo>> kept;
+    size_t next = 0;
+    for (const shared_ptr<ChunkInfo>& chunk: chunks)
+    {
+        if (next < replaced.size() && replaced[next]->id == chunk->id) {
+            kept.push_back(replaced[next++]);
+        } else if (find(removed.begin(), removed.end(), chunk->id) == removed.end()) {
+            kept.push_back(chunk);
+        }
+    }
+    chunks = move(kept);
+    rebuildPkIndex();
+    writeManifest();
+    cout << "Таблица '" << tableName << "': очищено чанков: " << rewritten << endl;
+    return rewritten;
+}
+
+void Table::deleteData(const Vector<Condition*>& conditions)
+{
+    const Vector<Table*> targets = targetsFor(conditions, nullptr);
+    // Строки ищутся под разделяемой защёлкой, блокируются без неё и перепроверяются:
+    // писатели разных строк не ждут друг друга дольше, чем длится сама правка.
+    // Один порядок захвата у всех операторов (партиции, затем ключи) не даёт им заблокировать друг друга
+    Vector<unique_ptr<LockSet>> statementLocks;
+    Vector<Vector<int>> candidates;
+    Vector<Predicate> predicates;
+    for (Table* target: targets)
+    {
+        statementLocks.push_back(make_unique<LockSet>(target->locks));
+        LockSet& targetLocks = *statementLocks[statementLocks.size() - 1];
+        targetLocks.lockTable(LockManager::INTENT_EXCLUSIVE);
+        predicates.push_back(Predicate());
+        candidates.push_back(target->deleteCandidates(conditions, predicates[predicates.size() - 1]));
+        for (const int key: candidates[candidates.size() - 1]) {
+            targetLocks.lockRow(key, LockManager::EXCLUSIVE);
+        }
+    }
+
+    uint64_t lsn = 0;
+    {
+        const shared_lock<shared_mutex> gate = wal ? wal->enter() : shared_lock<shared_mutex>();
+        // Все строки оператора удаляются одной фиксацией, даже если лежат в разных партициях:
+        // снимок видит либо все удаления, либо ни одного. Сами версии остаются на месте
+        // для снимков, открытых раньше фиксации
+        Vector<unique_lock<shared_mutex>> latches;
+        for (Table* target: targets) {
+            latches.push_back(unique_lock<shared_mutex>(target->mutex));
+        }
+        Vector<string> deletedKeys;
+        Vector<Vector<RowLocation>> deleted;
+        deleted.resize(targets.size(), Vector<RowLocation>());
+        for (size_t i = 0; i < targets.size(); i++) {
+            targets[i]->matchLiveRows(candidates[i], predicates[i], deletedKeys, deleted[i]);
+        }
+        // С журналом метка выдаётся вместе с записью: снимки увидят удаление, когда она на диске
+        uint64_t stamp = 0;
+        if (!wal) {
+            stamp = clock->commit();
+        } else if (!deletedKeys.empty()) {
+            lsn = wal->append(WriteAheadLog::DELETE, tableName, deletedKeys, stamp);
+        }
+        for (size_t i = 0; i < targets.size(); i++) {
+            for (const RowLocation& location: deleted[i]) {
+                targets[i]->chunks[location.chunk]->expire(location.slot, stamp);
+            }
+        }
+        // Открытых снимков старше удаления нет: версии собираются сразу, не дожидаясь сборщика
+        const bool collect = clock->horizon() >= stamp;
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            if (collect) {
+                targets[i]->collectDeleted(deleted[i]);
+            }
+            if (!wal) {
+                targets[i]->flushChunks();
+            }
+        }
+    }
+    if (wal && lsn > 0) {
+        wal->waitDurable(lsn);
+    }
+}
+
+Vector<int> Table::deleteCandidates(const Vector<Condition*>& conditions, Predicate& predicate)
+{
+    Vector<int> candidates;
+    {
+        shared_lock<shared_mutex> lock(mutex);
+        bindConditions(conditions);
+        predicate = Predicate::compile(conditions, layout);
+        Vector<int> keys;
+        if (lookupKeys(conditions, keys))
+        {
+            for (const int key: keys)
+            {
+                const RowLocation location = locate(key);
+                if (location.chunk != -1 && chunks[location.chunk]->isLive(location.slot) &&
+                    predicate.matches(rowAt(location))) {
+                    candidates.push_back(key);
+                }
+            }
+        } else
+        {
+            forEachBatchMatching(conditions, nullptr, [&](const ChunkInfo& chunk, Vector<int>& selection) {
+                predicate.filter(chunk, selection);
+                for (const int slot: selection) {
+                    candidates.push_back(parseKey(chunk.value(0, slot)));
+                }
+            });
+        }
     }
-    lineCount = lineCount - 1;
-    file.close();
+    sort(candidates.begin(), candidates.end());
+    return candidates;
+}
 
-    if (lineCount >= tuplesLimit)
+void Table::matchLiveRows(const Vector<int>& candidates, const Predicate& predicate,
+                          Vector<string>& keys, Vector<RowLocation>& locations) const
+{
+    for (const int key: candidates)
     {
-        currentFile = createNewFile();
+        const RowLocation location = locate(key);
+        if (location.chunk != -1 && chunks[location.chunk]->isLive(location.slot) &&
+            predicate.matches(rowAt(location))) {
+            keys.push_back(chunks[location.chunk]->value(0, location.slot));
+            locations.push_back(location);
+        }
     }
-    writeDataToFile(currentFile, values);
-    PK++;
-    writePK();
-    unlockTable();
 }
 
-Vector<string> Table::splitLine(const string& line)
+void Table::collectDeleted(const Vector<RowLocation>& deleted)
 {
-    Vector<string> splitted;
-    stringstream ss(line);
-    string token;
-    while (getline(ss, token, ',')) {
-        splitted.push_back(token);
+    if (deleted.empty()) {
+        return;
+    }
+    for (const RowLocation& location: deleted) {
+        markDead(location);
     }
-    return splitted;
 }
 
-Vector<Vector<string>> Table::selectAll()
+size_t Table::updateData(const Vector<Assignment>& assignments, const Vector<Condition*>& conditions)
 {
-    Vector<Vector<string>> allData;
-    Vector<string> headers = getAllColumns(tableName);
-    allData.push_back(headers);
-    Vector<string> files;
-    string cc = "1";
-    while (exists(path + "/" + cc + ".csv"))
+    // SET принимает и «колонка», и «таблица.колонка»; значения приводятся к типам до блокировки
+    const Vector<ColumnData>& types = partitions.empty() ? layout : partitions[0]->layout;
+    auto resolve = [this](const string& column) {
+        const int position = getColumnIndex(column);
+        return position != -1 ? position : getColumnIndex(tableName + "." + column);
+    };
+    Vector<Assignment> bound;
+    for (const Assignment& assignment: assignments)
     {
-        files.push_back(path + "/" + cc + ".csv");
-        cc = to_string(stoi(cc) + 1);
+        Assignment resolved = assignment;
+        resolved.position = resolve(assignment.column);
+        if (resolved.position == -1) {
+            throw runtime_error("Неизвестная колонка в SET: " + assignment.column);
+        }
+        if (resolved.position == 0) {
+            throw runtime_error("PK таблицы '" + tableName + "' не меняется");
+        }
+        if (assignment.operation == 0) {
+            resolved.value = types[resolved.position].type.canonical(assignment.value);
+        } else
+        {
+            resolved.sourcePosition = resolve(assignment.source);
+            if (resolved.sourcePosition == -1) {
+                throw runtime_error("Неизвестная колонка в SET: " + assignment.source);
+            }
+        }
+        bound.push_back(move(resolved));
     }
-
-    for (const string& file: files)
+    const Vector<Table*> targets = targetsFor(conditions, nullptr);
+    // Строка, у которой меняется колонка партиционирования, переезжает: партиция назначения
+    // блокируется и защёлкивается вместе с источниками, в общем порядке партиций.
+    // Если новое значение вычисляется по строке, назначением может оказаться любая партиция
+    Vector<Table*> involved;
+    if (partitions.empty()) {
+        involved = targets;
+    } else
     {
-        ifstream oneFile(file);
-        string line;
+        Table* destination = nullptr;
+        bool anyDestination = false;
+        for (const Assignment& assignment: bound) {
+            if (assignment.position == partitionColumn && assignment.operation == 0) {
+                destination = partitions[partitionOf(assignment.value)];
+            } else if (assignment.position == partitionColumn) {
+                anyDestination = true;
+            }
+        }
+        for (Table* partition: partitions) {
+            if (anyDestination || partition == destination ||
+                find(targets.begin(), targets.end(), partition) != targets.end()) {
+                involved.push_back(partition);
+            }
+        }
+    }
+    Vector<unique_ptr<LockSet>> statementLocks;
+    Vector<Vector<int>> candidates;
+    Vector<Predicate> predicates;
+    for (Table* table: involved)
+    {
+        statementLocks.push_back(make_unique<LockSet>(table->locks));
+        LockSet& tableLocks = *statementLocks[statementLocks.size() - 1];
+        tableLocks.lockTable(LockManager::INTENT_EXCLUSIVE);
+        predicates.push_back(Predicate());
+        if (find(targets.begin(), targets.end(), table) == targets.end()) {
+            candidates.push_back(Vector<int>());
+            continue;
+        }
+        candidates.push_back(table->deleteCandidates(conditions, predicates[predicates.size() - 1]));
+        for (const int key: candidates[candidates.size() - 1]) {
+            tableLocks.lockRow(key, LockManager::EXCLUSIVE);
+        }
+    }
 
-        if (getline(oneFile, line))
+    size_t updated = 0;
+    uint64_t lsn = 0;
+    {
+        const shared_lock<shared_mutex> gate = wal ? wal->enter() : shared_lock<shared_mutex>();
+        Vector<unique_lock<shared_mutex>> latches;
+        for (Table* table: involved) {
+            latches.push_back(unique_lock<shared_mutex>(table->mutex));
+        }
+        // Новые значения вычисляются до фиксации: ошибка в выражении любой строки
+        // отменяет оператор, пока ни одна версия не тронута
+        Vector<RowRevision> revisions;
+        for (size_t i = 0; i < involved.size(); i++) {
+            involved[i]->reviseRows(candidates[i], predicates[i], bound, revisions);
+        }
+        // Вся правка — одна запись журнала: новые версии строк подряд, по width() полей
+        Vector<string> fields;
+        for (const RowRevision& revision: revisions) {
+            for (const string& value: revision.after) {
+                fields.push_back(value);
+            }
+        }
+        // Ячейки на месте не меняются: прежнюю версию снимок ещё может читать.
+        // Она истекает той же фиксацией, которой появляется новая с тем же ключом
+        uint64_t stamp = 0;
+        if (!wal) {
+            stamp = clock->commit();
+        } else if (!fields.empty()) {
+            lsn = wal->append(WriteAheadLog::UPDATE, tableName, fields, stamp);
+        }
+        Vector<Vector<RowLocation>> replaced;
+        replaced.resize(involved.size(), Vector<RowLocation>());
+        for (RowRevision& revision: revisions)
         {
-
+            Table* source = revision.source;
+            source->chunks[revision.location.chunk]->expire(revision.location.slot, stamp);
+            for (size_t i = 0; i < involved.size(); i++) {
+                if (involved[i] == source) {
+                    replaced[i].push_back(revision.location);
+                }
+            }
+            Table* destination = partitions.empty() ? this : partitionFor(revision.after);
+            if (destination == source) {
+                source->supersededRows++;
+            }
+            const int key = parseKey(revision.after[0]);
+            destination->appendRow(key, move(revision.after), stamp, destination == source ? &revision.before : nullptr);
         }
-
-        while (getline(oneFile, line)) {
-            Vector<string> row = splitLine(line);
-            allData.push_back(row);
+        updated = revisions.size();
+        const bool collect = clock->horizon() >= stamp;
+        for (size_t i = 0; i < involved.size(); i++)
+        {
+            if (collect) {
+                involved[i]->collectDeleted(replaced[i]);
+            }
+            if (!wal) {
+                involved[i]->flushChunks();
+            }
         }
-        oneFile.close();
     }
-    return allData;
+    if (wal && lsn > 0) {
+        wal->waitDurable(lsn);
+    }
+    return updated;
 }
 
-void Table::deleteData(const Vector<Condition*>& conditions)
+void Table::reviseRows(const Vector<int>& candidates, const Predicate& predicate,
+                       const Vector<Assignment>& assignments, Vector<RowRevision>& revisions)
 {
-    unique_lock<shared_mutex> lock(mutex);
-    lockTable();
-    Vector<string> files;
-    string cc = "1";
-    while (exists(path + "/" + cc + ".csv") == true)
-    {
-        files.push_back(path + "/" + cc + ".csv");
-        cc = to_string(stoi(cc) + 1);
-    }
-    int totalRowsRemaining = 0;
-    int fileIndex = 0;
-    for (const string& file: files)
+    for (const int key: candidates)
     {
-        fileIndex++;
-        Vector<Vector<string>> allRows;
-        ifstream oneFile(file);
-        string line;
-
-        if (getline(oneFile, line)) {
-            Vector<string> header = splitLine(line);
-            allRows.push_back(header);
+        const RowLocation location = locate(key);
+        if (location.chunk == -1 || !chunks[location.chunk]->isLive(location.slot) ||
+            !predicate.matches(rowAt(location))) {
+            continue;
         }
-
-        while (getline(oneFile, line)) {
-            Vector<string> row = splitLine(line);
-            allRows.push_back(row);
+        RowRevision revision;
+        revision.source = this;
+        revision.location = location;
+        revision.before = rowAt(location).materialize();
+        revision.after = revision.before;
+        // Выражения видят значения строки до правки, как в SQL
+        for (const Assignment& assignment: assignments)
+        {
+            if (assignment.operation == 0) {
+                revision.after[assignment.position] = assignment.value;
+            } else {
+                revision.after[assignment.position] = layout[assignment.position].type.arithmetic(
+                    revision.before[assignment.sourcePosition], assignment.operation, assignment.value);
+            }
         }
-        oneFile.close();
+        revisions.push_back(move(revision));
+    }
+}
 
-        Vector<Vector<string>> remainingRows;
-        remainingRows.push_back(allRows[0]);
-        for (int i = 1; i < allRows.size(); i++) {
-            if (!checkWhere(conditions, allRows[i])) {
-                remainingRows.push_back(allRows[i]);
-            }
+size_t Table::copyFrom(const string& filename)
+{
+    ifstream file(filename);
+    if (!file.is_open() || is_directory(filename)) {
+        throw runtime_error("Не удалось открыть файл для COPY");
+    }
+    Vector<Table*> targets;
+    if (partitions.empty()) {
+        targets.push_back(this);
+    } else {
+        targets = partitions;
+    }
+    // Загрузка идёт мимо журнала: другие писатели на её время не допускаются, строки
+    // складываются в новые чанки вне таблицы и становятся видны одной фиксацией,
+    // когда их файлы уже сброшены на диск. Ключи выдаются блоками, индексы
+    // пополняются один раз при публикации
+    Vector<unique_ptr<LockSet>> statementLocks;
+    Vector<BulkLoad> loads;
+    Vector<Vector<Vector<string>>> pending;
+    for (Table* target: targets)
+    {
+        statementLocks.push_back(make_unique<LockSet>(target->locks));
+        statementLocks[statementLocks.size() - 1]->lockTable(LockManager::EXCLUSIVE);
+        BulkLoad load;
+        {
+            shared_lock<shared_mutex> lock(target->mutex);
+            load.nextId = target->chunks.empty() ? 1 : target->chunks[target->chunks.size() - 1]->id + 1;
         }
-        totalRowsRemaining += (remainingRows.size() - 1);
-        if (remainingRows.size() > 1)
+        loads.push_back(move(load));
+        pending.push_back(Vector<Vector<string>>());
+    }
+    // У партиционированной таблицы своей раскладки нет, типы колонок берутся у партиции
+    const Vector<ColumnData>& types = targets[0]->layout;
+    Vector<string> defaults;
+    for (const ColumnData& column: types) {
+        defaults.push_back(column.numeric() ? column.type.format(0) : string());
+    }
+    Vector<int> positions;
+    for (size_t column = 1; column < width(); column++) {
+        positions.push_back(static_cast<int>(column));
+    }
+    // Ключи берутся у последовательности блоками и идут в порядке строк файла.
+    // Других писателей нет, поэтому блоки идут подряд и неудачная загрузка возвращает их все
+    int firstKey = 0;
+    int nextKey = 0;
+    int keysEnd = 0;
+
+    try
+    {
+        string line;
+        Vector<string_view> fields;
+        size_t lineNumber = 0;
+        bool first = true;
+        while (getline(file, line))
         {
-            ofstream rewriteFile(file);
-            for (const Vector<string>& row: remainingRows) {
-                string writeLine;
-                for (const string& cell: row) {
-                    writeLine += cell + ",";
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            splitLine(line, fields);
+            if (first)
+            {
+                first = false;
+                if (readCopyHeader(fields, positions)) {
+                    continue;
                 }
-                writeLine.pop_back();
-                rewriteFile << writeLine << endl;
             }
-            rewriteFile.close();
-        } else
-        {
-            if (fileIndex > 1)
+            if (fields.size() != positions.size()) {
+                throw runtime_error("Строка " + to_string(lineNumber) + ": ожидалось значений "
+                                    + to_string(positions.size()) + ", получено " + to_string(fields.size()));
+            }
+            Vector<string> row = defaults;
+            for (size_t i = 0; i < fields.size(); i++)
             {
-                remove(file.c_str());
+                // Ключи выдаёт таблица, значения PK из файла не используются
+                const int column = positions[i];
+                if (column <= 0) {
+                    continue;
+                }
+                const ColumnType& type = types[column].type;
+                int64_t number = 0;
+                if (type.isNumeric() && !type.parseValue(fields[i], number)) {
+                    throw runtime_error("Строка " + to_string(lineNumber) + ": значение колонки " + columns[column - 1]
+                                        + " не подходит для типа " + type.name());
+                }
+                row[column] = type.isNumeric() ? type.format(number) : string(fields[i]);
             }
-            else
+            if (nextKey == keysEnd)
             {
-                ofstream rewriteFile(file, ios::trunc);
-                string writeLine;
-                for (const string& cell: remainingRows[0]) {
-                    writeLine += cell + ",";
+                nextKey = reserveKeys(static_cast<int>(BULK_BATCH));
+                keysEnd = nextKey + static_cast<int>(BULK_BATCH);
+                if (firstKey == 0) {
+                    firstKey = nextKey;
                 }
-                writeLine.pop_back();
-                rewriteFile << writeLine << endl;
-                rewriteFile.close();
+            }
+            row[0] = to_string(nextKey++);
+            const size_t target = partitions.empty() ? 0 : partitionOf(row[partitionColumn]);
+            pending[target].push_back(move(row));
+            if (pending[target].size() >= BULK_BATCH) {
+                targets[target]->bulkAppend(loads[target], pending[target]);
+            }
+        }
+        releaseKeys(nextKey, keysEnd);
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            if (!pending[i].empty()) {
+                targets[i]->bulkAppend(loads[i], pending[i]);
+            }
+            targets[i]->writeBulk(loads[i], true);
+        }
+    } catch (...)
+    {
+        for (size_t i = 0; i < targets.size(); i++) {
+            targets[i]->discardBulk(loads[i]);
+        }
+        if (firstKey != 0) {
+            releaseKeys(firstKey, keysEnd);
+        }
+        throw;
+    }
+
+    // Манифест каждой партиции заменяется атомарно, но не все сразу: пока лежит метка,
+    // открытие таблицы отбрасывает загрузку во всех партициях
+    if (!partitions.empty())
+    {
+        string marker;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (!loads[i].chunks.empty()) {
+                marker += to_string(i) + " " + to_string(loads[i].chunks[0]->id) + "\n";
             }
         }
+        replaceFile(copyMarkerPath(), marker);
+        WriteAheadLog::syncFile(path);
     }
-    if (totalRowsRemaining == 0) {
-        resetPK();
+    size_t total = 0;
+    uint64_t lsn = 0;
+    {
+        Vector<unique_lock<shared_mutex>> latches;
+        for (Table* target: targets) {
+            latches.push_back(unique_lock<shared_mutex>(target->mutex));
+        }
+        // Чанки уже на диске, но снимки увидят их только после изменений, записанных в журнал раньше
+        uint64_t stamp = 0;
+        if (wal) {
+            lsn = wal->reserveStamp(stamp);
+        } else {
+            stamp = clock->commit();
+        }
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            targets[i]->publishBulk(loads[i], stamp);
+            total += loads[i].rows;
+            if (bulkPublishHook != nullptr) {
+                bulkPublishHook(i);
+            }
+        }
+        // Все манифесты на диске: загрузка зафиксирована до того, как её увидят читатели
+        if (!partitions.empty())
+        {
+            remove(copyMarkerPath());
+            WriteAheadLog::syncFile(path);
+        }
+    }
+    if (wal) {
+        wal->waitDurable(lsn);
     }
-    unlockTable();
+    return total;
 }
 
-bool Table::checkWhere(const Vector<Condition*>& conditions, const Vector<string>& row)
+bool Table::readCopyHeader(const Vector<string_view>& fields, Vector<int>& positions) const
 {
-    if (conditions.empty()) return true;
-    for (const Condition* cond: conditions)
+    // Первая строка — заголовок, если каждое её поле называет колонку таблицы:
+    // как в файлах чанков (lot_pk,lot.name) или коротко (name)
+    Vector<int> named;
+    for (const string_view field: fields)
     {
-        if (checkCondition(*cond, row)) return true;
+        int column = getColumnIndex(field);
+        for (size_t i = 0; column == -1 && i < columns.size(); i++) {
+            if (field == columns[i]) {
+                column = static_cast<int>(i) + 1;
+            }
+        }
+        if (column == -1) {
+            return false;
+        }
+        named.push_back(column);
     }
-    return false;
+    positions = named;
+    return true;
 }
 
-bool Table::checkCondition(const Condition& condition, const Vector<string>& row)
+void Table::bulkAppend(BulkLoad& load, Vector<Vector<string>>& rows)
 {
-    if (condition.getSign() == "=")
     {
-        int index = -1;
-        if (condition.getName() == tableName + "_pk") index = 0;
-        else
+        // Словари колонок общие с опубликованными чанками: пополняются только под защёлкой
+        unique_lock<shared_mutex> lock(mutex, defer_lock);
+        for (const ColumnData& column: layout) {
+            if (column.encoded()) {
+                lock.lock();
+                break;
+            }
+        }
+        for (Vector<string>& row: rows)
         {
-            for (int i = 0; i < columns.size(); i++) {
-                if (condition.getName() == tableName + "." + columns[i]) {
-                    index = i + 1;
-                    break;
-                }
+            if (load.chunks.empty() || load.chunks[load.chunks.size() - 1]->rowCount() >= tuplesLimit)
+            {
+                load.chunks.push_back(newChunk(load.nextId++));
+                initZone(*load.chunks[load.chunks.size() - 1]);
             }
+            ChunkInfo& chunk = *load.chunks[load.chunks.size() - 1];
+            chunk.zone.add(row);
+            chunk.appendRow(move(row));
+        }
+    }
+    load.rows += rows.size();
+    rows.clear();
+    writeBulk(load, false);
+}
+
+void Table::publishBulk(const BulkLoad& load, const uint64_t stamp)
+{
+    if (load.chunks.empty()) {
+        return;
+    }
+    for (const shared_ptr<ChunkInfo>& chunk: load.chunks)
+    {
+        for (int slot = 0; slot < chunk->rowCount(); slot++) {
+            chunk->created[slot] = stamp;
         }
-        if (index != -1 && index < row.size() && row[index] == condition.getValue())
+        chunks.push_back(chunk);
+        const int position = static_cast<int>(chunks.size()) - 1;
+        for (int slot = 0; slot < chunk->rowCount(); slot++)
         {
-            return true;
+            const RowView row(*chunk, slot);
+            const int key = parseKey(row[0]);
+            indexRow(key, position, slot);
+            for (HashIndex* index: indexes) {
+                index->add(row, key);
+            }
+            for (OrderedIndex* index: orderedIndexes) {
+                index->add(row, key);
+            }
         }
     }
+    // Чанки уже на диске: загрузка переживёт сбой, как только их увидит манифест
+    writeManifest();
+    WriteAheadLog::syncFile(manifestPath());
+}
+
+void Table::bindConditions(const Vector<Condition*>& conditions, const Vector<string>* references) const
+{
+    for (const Condition* condition: conditions) {
+        bindCondition(*condition, references);
+    }
+}
 
-    else if (condition.getSign() == "AND")
+void Table::bindCondition(const Condition& condition, const Vector<string>* references) const
+{
+    if (condition.getSign() == "AND" || condition.getSign() == "OR")
     {
-        if (!condition.getLeft() || !condition.getRight()) {
-            return false;
+        if (condition.getLeft()) {
+            bindCondition(*condition.getLeft(), references);
+        }
+        if (condition.getRight()) {
+            bindCondition(*condition.getRight(), references);
+        }
+        return;
+    }
+    const int column = getColumnIndex(condition.getName());
+    if (column == -1) {
+        // Условие на колонку другой таблицы соединения
+        return;
+    }
+    ConditionBinding binding;
+    binding.bound = true;
+    binding.column = column;
+    binding.value = condition.getValue();
+    if (references != nullptr) {
+        for (const string& reference: *references) {
+            if (reference == condition.getValue()) {
+                condition.bind(move(binding));
+                return;
+            }
         }
-        return checkCondition(*condition.getLeft(), row) &&
-               checkCondition(*condition.getRight(), row);
     }
-    else if (condition.getSign() == "OR")
+    // Литерал проверяется и переводится в тип колонки один раз на запрос
+    const ColumnData& data = layout[column];
+    if (data.numeric())
     {
-        if (!condition.getLeft() && !condition.getRight()) {
-            return false;
+        if (!data.type.parseValue(condition.getValue(), binding.number)) {
+            throw runtime_error("Значение " + condition.getValue() + " не подходит для колонки " +
+                                condition.getName() + " типа " + data.type.name());
         }
-        return checkCondition(*condition.getLeft(), row) ||
-               checkCondition(*condition.getRight(), row);
+        binding.numeric = true;
+        binding.value = data.type.format(binding.number);
+    } else if (data.encoded() && condition.getSign() == "=")
+    {
+        binding.dictionary = data.dictionary;
+        binding.code = data.dictionary->find(condition.getValue());
     }
-    return false;
+    condition.bind(move(binding));
+}
+
+int Table::getColumnIndex(const string_view column) const
+{
+    const string_view table = tableName;
+    if (column.size() <= table.size() || column.substr(0, table.size()) != table) {
+        return -1;
+    }
+    const string_view rest = column.substr(table.size());
+    if (rest == "_pk") {
+        return 0;
+    }
+    if (rest[0] != '.') {
+        return -1;
+    }
+    for (int i = 0; i < columns.size(); i++) {
+        if (rest.substr(1) == columns[i]) {
+            return i + 1;
+        }
+    }
+    return -1;
 }
 
 Vector<int> Table::getColumnIndexes(const Vector<string>& headers) const
 {
     Vector<int> indexes;
     for (const string& column: headers) {
-        int index = -1;
-
-        if (column == tableName + "_pk") {
-            index = 0;
-        } else {
-            for (int i = 0; i < columns.size(); i++) {
-                if (column == tableName + "." + columns[i]) {
-                    index = i + 1;
-                    break;
-                }
-            }
-        }
-
+        const int index = getColumnIndex(column);
         if (index != -1) {
             indexes.push_back(index);
         }
@@ -232,25 +1563,265 @@ Vector<int> Table::getColumnIndexes(const Vector<string>& headers) const
     return indexes;
 }
 
-Vector<Vector<string>> Table::findData(const Vector<string>& headers, const Vector<Condition*>& conditions)
+void Table::pinChunks(TableSnapshot& snapshot, const Vector<Condition*>* conditions,
+                      const Vector<string>* references) const
+{
+    for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+        if (conditions == nullptr || chunkMayMatch(*chunk, *conditions, references)) {
+            snapshot.chunks.push_back({chunk, chunk->rowCount()});
+        }
+    }
+}
+
+Vector<Vector<string>> Table::joinRows(const uint64_t timestamp, const Vector<Condition*>& conditions,
+                                       const Vector<Condition*>& joinConditions, const Vector<string>& references)
+{
+    // Свои условия выбирают строки так же, как в запросе к одной таблице: через партиции,
+    // индексы и сводки чанков. Условия соединения только привязываются: литералы в них
+    // сравниваются с колонками этой таблицы в канонической записи
+    const Vector<Table*> targets = targetsFor(conditions, nullptr);
+    Vector<ScanPlan> plans;
+    Vector<Vector<RowView>> matched;
+    for (Table* target: targets)
+    {
+        {
+            shared_lock<shared_mutex> lock(target->mutex);
+            target->bindConditions(joinConditions, &references);
+        }
+        plans.push_back(ScanPlan());
+        ScanPlan& plan = plans[plans.size() - 1];
+        plan.pinned.timestamp = timestamp;
+        target->planScan(plan, conditions, -1, false);
+        matched.push_back(Vector<RowView>());
+        target->matchRows(plan, matched[matched.size() - 1]);
+    }
+    const Vector<RowView> rows = inKeyOrder(matched, targets.size() == 1 && !plans[0].keysUnordered);
+    Vector<Vector<string>> result;
+    result.reserve(rows.size());
+    for (const RowView& row: rows) {
+        result.push_back(row.materialize());
+    }
+    return result;
+}
+
+Vector<RowView> Table::inKeyOrder(Vector<Vector<RowView>>& matched, const bool sorted)
+{
+    if (sorted) {
+        return move(matched[0]);
+    }
+    // Строки выдаются по возрастанию ключа, как их вставляли. Новая версия после UPDATE
+    // лежит в хвосте, поэтому обход такой таблицы или нескольких партиций сортируется по ключу
+    Vector<pair<int, RowView>> keyed;
+    for (const Vector<RowView>& part: matched) {
+        for (const RowView& row: part) {
+            keyed.push_back({parseKey(row[0]), row});
+        }
+    }
+    sort(keyed.begin(), keyed.end(), [](const pair<int, RowView>& left, const pair<int, RowView>& right) {
+        return left.first < right.first;
+    });
+    Vector<RowView> rows;
+    rows.reserve(keyed.size());
+    for (const pair<int, RowView>& entry: keyed) {
+        rows.push_back(entry.second);
+    }
+    return rows;
+}
+
+void Table::planScan(ScanPlan& plan, const Vector<Condition*>& conditions, const int orderIndex,
+                     const bool descending) const
 {
+    // Под защёлкой условия привязываются, чанки закрепляются и читаются индексы;
+    // сами строки проверяются и копируются уже без неё
     shared_lock<shared_mutex> lock(mutex);
-    const Vector<Vector<string>> allData = selectAll();
+    bindConditions(conditions);
+    plan.predicate = Predicate::compile(conditions, layout);
+    Vector<int> keys;
+    // При ORDER BY точечный поиск по PK или хеш-индексу обычно даёт меньше строк, чем обход дерева
+    const OrderedIndex* index = orderIndex == -1 ? nullptr : orderedIndexOn(orderIndex);
+    if (lookupKeys(conditions, keys, orderIndex == -1))
+    {
+        // Ключи отсортированы, а строки лежат в порядке ключей: закрепляется каждый чанк по разу
+        int lastPinned = -1;
+        for (const int key: keys)
+        {
+            const RowLocation location = locate(key);
+            if (location.chunk == -1) {
+                continue;
+            }
+            if (replacedAfter(location, plan.pinned.timestamp)) {
+                planFullScan(plan, conditions);
+                return;
+            }
+            if (location.chunk != lastPinned) {
+                plan.pinned.chunks.push_back({chunks[location.chunk], chunks[location.chunk]->rowCount()});
+                lastPinned = location.chunk;
+            }
+            plan.candidates.push_back(rowAt(location));
+        }
+    } else if (index != nullptr)
+    {
+        OrderedBound low, high;
+        if (conditions.size() == 1)
+        {
+            Vector<const Condition*> comparisons;
+            collectComparisons(*conditions[0], comparisons);
+            rangeFor(*index, comparisons, low, high);
+        }
+        pinChunks(plan.pinned, nullptr, nullptr);
+        bool replaced = false;
+        index->scan(low, high, descending, [&](const int key, const OrderedKey& value) {
+            const RowLocation location = locate(key);
+            if (location.chunk == -1) {
+                return true;
+            }
+            if (replacedAfter(location, plan.pinned.timestamp)) {
+                replaced = true;
+                return false;
+            }
+            // У ключа есть записи и прежних версий: строка берётся по записи своей последней версии
+            if (supersededRows > 0 &&
+                OrderedKey::compare(value, OrderedKey::parse(rowAt(location)[index->getColumn()])) != 0) {
+                return true;
+            }
+            plan.candidates.push_back(rowAt(location));
+            return true;
+        });
+        if (replaced) {
+            planFullScan(plan, conditions);
+            return;
+        }
+        plan.ordered = true;
+    } else
+    {
+        planFullScan(plan, conditions);
+    }
+}
+
+bool Table::replacedAfter(const RowLocation& location, const uint64_t timestamp) const
+{
+    // Версия моложе снимка могла заменить ту, что он видит, а к прежней версии ключ уже не ведёт
+    return supersededRows > 0 && chunks[location.chunk]->created[location.slot] > timestamp;
+}
+
+void Table::planFullScan(ScanPlan& plan, const Vector<Condition*>& conditions) const
+{
+    plan.pinned.chunks.clear();
+    plan.candidates.clear();
+    pinChunks(plan.pinned, &conditions, nullptr);
+    plan.scan = true;
+    plan.keysUnordered = keysUnordered;
+}
+
+void Table::matchRows(const ScanPlan& plan, Vector<RowView>& matched)
+{
+    if (plan.scan)
+    {
+        // Условие проверяется пачками по колонкам; строки собираются только по выбранным слотам
+        plan.pinned.forEachBatch([&](const ChunkInfo& chunk, Vector<int>& selection) {
+            plan.predicate.filter(chunk, selection);
+            for (const int slot: selection) {
+                matched.push_back(RowView(chunk, slot));
+            }
+        });
+        return;
+    }
+    for (const RowView& row: plan.candidates) {
+        if (row.visible(plan.pinned.timestamp) && plan.predicate.matches(row)) {
+            matched.push_back(row);
+        }
+    }
+}
+
+Vector<Vector<string>> Table::findData(const Vector<string>& headers, const Vector<Condition*>& conditions,
+                                       const string& orderColumn, const bool descending)
+{
+    const int orderIndex = orderColumn.empty() ? -1 : getColumnIndex(orderColumn);
+    if (!orderColumn.empty() && orderIndex == -1) {
+        throw runtime_error("Неизвестная колонка ORDER BY: " + orderColumn);
+    }
+    // Все партиции читаются в одном снимке
+    const ReadSnapshot snapshot(*clock);
+    const Vector<Table*> targets = targetsFor(conditions, nullptr);
+    Vector<ScanPlan> plans;
+    for (Table* target: targets) {
+        plans.push_back(ScanPlan());
+        ScanPlan& plan = plans[plans.size() - 1];
+        plan.pinned.timestamp = snapshot.timestamp();
+        target->planScan(plan, conditions, orderIndex, descending);
+    }
+
+    // Крупные партиции делятся между потоками (не больше, чем ядер), мелкие проверяет вызывающий поток
+    Vector<Vector<RowView>> matched;
+    Vector<exception_ptr> failures;
+    Vector<size_t> large;
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        matched.push_back(Vector<RowView>());
+        failures.push_back(nullptr);
+        size_t work = plans[i].candidates.size();
+        for (const ChunkPin& pin: plans[i].pinned.chunks) {
+            work += plans[i].scan ? pin.rows : 0;
+        }
+        if (work >= PARALLEL_ROWS) {
+            large.push_back(i);
+        }
+    }
+    auto match = [&](const size_t i) {
+        try {
+            targets[i]->matchRows(plans[i], matched[i]);
+        } catch (...) {
+            failures[i] = current_exception();
+        }
+    };
+    const size_t shares = min(large.size(), static_cast<size_t>(max(1U, thread::hardware_concurrency())));
+    auto matchShare = [&](const size_t share) {
+        for (size_t j = share; j < large.size(); j += shares) {
+            match(large[j]);
+        }
+    };
+    Vector<thread> workers;
+    for (size_t share = 1; share < shares; share++) {
+        workers.push_back(thread(matchShare, share));
+    }
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (shares <= 1 || find(large.begin(), large.end(), i) == large.end()) {
+            match(i);
+        }
+    }
+    if (shares > 1) {
+        matchShare(0);
+    }
+    for (thread& worker: workers) {
+        worker.join();
+    }
+    for (const exception_ptr& failure: failures) {
+        if (failure) {
+            rethrow_exception(failure);
+        }
+    }
+
+    Vector<RowView> rows = inKeyOrder(matched, targets.size() == 1 && !plans[0].keysUnordered);
+    const bool sortRows = orderIndex != -1 && !(targets.size() == 1 && plans[0].ordered);
+    if (sortRows) {
+        stable_sort(rows.begin(), rows.end(), [orderIndex, descending](const RowView& left, const RowView& right) {
+            const int cmp = left.compare(orderIndex, right);
+            return descending ? cmp > 0 : cmp < 0;
+        });
+    }
+
     Vector<Vector<string>> result;
     result.push_back(headers);
     const Vector<int> indexes = getColumnIndexes(headers);
-
-    for (size_t i = 1; i < allData.size(); i++) {
-        const Vector<string>& row = allData[i];
-        if (checkWhere(conditions, row)) {
-            Vector<string> selectedRow;
-            for (const int index: indexes) {
-                if (index < row.size()) {
-                    selectedRow.push_back(row[index]);
-                }
+    for (const RowView& row: rows)
+    {
+        Vector<string> selectedRow;
+        for (const int index: indexes) {
+            if (index < row.size()) {
+                selectedRow.push_back(row[index]);
             }
-            result.push_back(selectedRow);
         }
+        result.push_back(move(selectedRow));
     }
     return result;
 }
@@ -264,3 +1835,66 @@ Vector<string> Table::getAllColumns(const string& tableName) const
     }
     return names;
 }
+
+size_t Table::rowCount() const
+{
+    size_t count = 0;
+    for (const Table* partition: partitions) {
+        count += partition->rowCount();
+    }
+    shared_lock<shared_mutex> lock(mutex);
+    for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+        count += chunk->rowCount() - chunk->deadCount - chunk->pendingCount;
+    }
+    return count;
+}
+
+size_t Table::memoryUsage() const
+{
+    size_t bytes = 0;
+    for (const Table* partition: partitions) {
+        bytes += partition->memoryUsage();
+    }
+    shared_lock<shared_mutex> lock(mutex);
+    bytes += sizeof(Vector<shared_ptr<ChunkInfo>>) + chunks.size() * (sizeof(shared_ptr<ChunkInfo>) + sizeof(ChunkInfo));
+    for (const shared_ptr<ChunkInfo>& pointer: chunks) {
+        const ChunkInfo& chunk = *pointer;
+        bytes += chunk.zone.memoryUsage();
+        bytes += chunk.rowCount() * sizeof(bool);
+        bytes += chunk.capacity * (sizeof(uint64_t) + sizeof(atomic<uint64_t>));
+        for (const ColumnData& column: chunk.columns) {
+            bytes += sizeof(ColumnData) + column.numbers.size() * sizeof(int64_t) +
+                     column.values.size() * sizeof(string) + column.codes.size() * sizeof(uint16_t);
+            for (const string& cell: column.values) {
+                bytes += cell.capacity();
+            }
+        }
+    }
+    bytes += pkIndex.size() * sizeof(RowLocation);
+    for (const HashIndex* index: indexes) {
+        bytes += index->memoryUsage();
+    }
+    for (const ColumnData& column: layout) {
+        if (column.dictionary != nullptr) {
+            bytes += column.dictionary->memoryUsage();
+        }
+    }
+    return bytes;
+}
+
+LockStats Table::lockStats() const
+{
+    LockStats total = locks.snapshot();
+    for (const Table* partition: partitions)
+    {
+        const LockStats stats = partition->lockStats();
+        total.granted += stats.granted;
+        total.waited += stats.waited;
+        total.timeouts += stats.timeouts;
+        total.waitMicros += stats.waitMicros;
+        total.maxWaitMicros = max(total.maxWaitMicros, stats.maxWaitMicros);
+        total.held += stats.held;
+        total.waiting += stats.waiting;
+    }
+    return total;
+}
@@ -1,13 +1,41 @@
 #ifndef TABLE_H
 #define TABLE_H
+#include "columntype.h"
+#include "dictionary.h"
+#include "hashindex.h"
+#include "lockmanager.h"
+#include "orderedindex.h"
 #include "vector.h"
+#include "versionclock.h"
+#include "wal.h"
+#include "zonemap.h"
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <filesystem>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <string_view>
 using namespace std;
 using namespace filesystem;
 
+// Условие, разобранное таблицей один раз перед сканированием
+struct ConditionBinding
+{
+    bool bound = false;
+    int column = -1;
+    // Код значения в словаре колонки (-1 — значения в словаре нет). У партиций словари
+    // свои, поэтому код годится только для чанков с тем же словарём
+    const Dictionary* dictionary = nullptr;
+    int code = -1;
+    // Значение для числовой колонки
+    bool numeric = false;
+    int64_t number = 0;
+    // Каноническая запись значения: с ней сравниваются индексы и сводки чанков
+    string value;
+};
+
 class Condition
 {
 private:
@@ -16,6 +44,7 @@ private:
     string sign;
     Condition* left;
     Condition* right;
+    mutable ConditionBinding binding;
 public:
     Condition(string  col, string  val, string  op = "=")
         : name(move(col)), value(move(val)), sign(move(op)), left(nullptr), right(nullptr) {}
@@ -23,15 +52,481 @@ public:
     Condition(string  op, Condition* l, Condition* r)
         : sign(move(op)), left(l), right(r) {}
 
-    [[nodiscard]] string getName() const {return name;}
-    [[nodiscard]] string getValue() const {return value;}
-    [[nodiscard]] string getSign() const {return sign;}
+    [[nodiscard]] const string& getName() const {return name;}
+    [[nodiscard]] const string& getValue() const {return value;}
+    [[nodiscard]] const string& getSign() const {return sign;}
     [[nodiscard]] Condition* getLeft() const {return left;}
     [[nodiscard]] Condition* getRight() const {return right;}
+    void bind(ConditionBinding resolved) const {binding = move(resolved);}
+    [[nodiscard]] const ConditionBinding& getBinding() const {return binding;}
+    // Значение условия в канонической записи колонки, если условие уже привязано к таблице
+    [[nodiscard]] const string& getBoundValue() const {return binding.bound ? binding.value : value;}
+    [[nodiscard]] bool isRange() const {return sign == "<" || sign == "<=" || sign == ">" || sign == ">=";}
+    // Результат сравнения значения строки со значением условия (<0, 0, >0) для операторов диапазона
+    [[nodiscard]] bool accepts(const int cmp) const
+    {
+        if (sign == "<") return cmp < 0;
+        if (sign == "<=") return cmp <= 0;
+        if (sign == ">") return cmp > 0;
+        if (sign == ">=") return cmp >= 0;
+        return cmp == 0;
+    }
     ~Condition() = default;
 };
 
 
+// Присваивание SET: колонка = value или колонка = source operation value, где operation — '+' или '-'.
+// Позиции колонок заполняет таблица
+struct Assignment
+{
+    string column;
+    string value;
+    string source;
+    char operation = 0;
+    int position = -1;
+    int sourcePosition = -1;
+};
+
+// Значения колонки чанка: числа для INT и DECIMAL, строки или коды общего словаря для TEXT.
+// Слоты читаются через begin(): снимки обращаются к ним без защёлки, пока писатель
+// дописывает колонку и меняет её размер
+struct ColumnData
+{
+    ColumnType type;
+    Vector<int64_t> numbers;
+    Vector<string> values;
+    Vector<uint16_t> codes;
+    Dictionary* dictionary = nullptr;
+
+    [[nodiscard]] bool numeric() const {return type.isNumeric();}
+    [[nodiscard]] bool encoded() const {return dictionary != nullptr;}
+    [[nodiscard]] size_t size() const
+    {
+        return numeric() ? numbers.size() : encoded() ? codes.size() : values.size();
+    }
+    // Только для колонок TEXT
+    [[nodiscard]] const string& text(const size_t slot) const
+    {
+        return encoded() ? dictionary->value(codes.begin()[slot]) : values.begin()[slot];
+    }
+    [[nodiscard]] int64_t number(const size_t slot) const {return numbers.begin()[slot];}
+    [[nodiscard]] uint16_t code(const size_t slot) const {return codes.begin()[slot];}
+    [[nodiscard]] string at(const size_t slot) const
+    {
+        return numeric() ? type.format(number(slot)) : text(slot);
+    }
+    // Значение, которое не поместится в заполненный словарь и заставит хранить колонку строками
+    [[nodiscard]] bool needsDecode(const string& value) const
+    {
+        return encoded() && dictionary->size() >= Dictionary::LIMIT && dictionary->find(value) == -1;
+    }
+    void reserve(const size_t capacity)
+    {
+        if (numeric()) {
+            numbers.reserve(capacity);
+        } else if (encoded()) {
+            codes.reserve(capacity);
+        } else {
+            values.reserve(capacity);
+        }
+    }
+    void append(string&& value)
+    {
+        if (numeric())
+        {
+            int64_t number = 0;
+            if (!type.parseValue(value, number)) {
+                throw runtime_error("Значение " + value + " не подходит для типа " + type.name());
+            }
+            numbers.push_back(number);
+            return;
+        }
+        if (encoded())
+        {
+            const int code = dictionary->encode(value);
+            if (code != -1) {
+                codes.push_back(static_cast<uint16_t>(code));
+                return;
+            }
+            decode();
+        }
+        values.push_back(move(value));
+    }
+    // Словарь заполнен: дальше этот чанк хранит колонку строками
+    void decode()
+    {
+        for (const uint16_t code: codes) {
+            values.push_back(dictionary->value(code));
+        }
+        codes.clear();
+        dictionary = nullptr;
+    }
+    void truncate(const size_t count)
+    {
+        if (numeric()) {
+            numbers.resize(count, 0);
+        } else if (encoded()) {
+            codes.resize(count, 0);
+        } else {
+            values.resize(count, string());
+        }
+    }
+};
+
+struct ChunkInfo
+{
+    // Столько слотов сканирование отбирает и фильтрует за один проход по колонкам
+    static constexpr int BATCH = 1024;
+
+    int id = 0;
+    size_t bytes = 0;
+    // Значения лежат по колонкам: columns[0] — PK, дальше колонки схемы.
+    // Сканирование условия по одной колонке идёт по одному непрерывному массиву
+    Vector<ColumnData> columns;
+    int rows = 0;
+    // Слоты, под которые уже выделены колонки и метки версий. До этой границы строки
+    // дописываются на месте, не сдвигая данные, которые читают снимки
+    int capacity = 0;
+    // Метки фиксации вставки и удаления строки (0 — строка не удалена)
+    unique_ptr<uint64_t[]> created;
+    unique_ptr<atomic<uint64_t>[]> expired;
+    // Удалённые строки, которые ещё может видеть открытый снимок; сборщик переводит их в dead
+    int pendingCount = 0;
+    // Битовая карта строк, не видных уже никому: слоты не переиспользуются до очистки чанка
+    Vector<bool> dead;
+    int deadCount = 0;
+    // Изменения, которые пока есть только в памяти и в журнале
+    int flushedRows = 0;
+    bool deadDirty = false;
+    // Сводка для пропуска чанка при сканировании, хранится рядом в N.zone
+    ZoneMap zone;
+
+    [[nodiscard]] int rowCount() const {return rows;}
+    [[nodiscard]] bool isDead(const size_t slot) const {return dead[slot];}
+    // Последняя зафиксированная версия: её видят писатели
+    [[nodiscard]] bool isLive(const size_t slot) const {return expiredAt(slot) == 0;}
+    [[nodiscard]] uint64_t expiredAt(const size_t slot) const {return expired[slot].load(memory_order_acquire);}
+    [[nodiscard]] bool visible(const size_t slot, const uint64_t timestamp) const
+    {
+        const uint64_t end = expiredAt(slot);
+        return created[slot] <= timestamp && (end == 0 || end > timestamp);
+    }
+    [[nodiscard]] string value(const size_t column, const size_t slot) const {return columns[column].at(slot);}
+    // Вектор выбора: видимые снимку timestamp слоты [begin, end) по возрастанию.
+    // При UINT64_MAX отбираются последние версии, как у isLive
+    void selectVisible(const int begin, const int end, const uint64_t timestamp, Vector<int>& selection) const
+    {
+        selection.resize(end - begin, 0);
+        int* slots = selection.begin();
+        size_t kept = 0;
+        for (int slot = begin; slot < end; slot++)
+        {
+            const uint64_t expiredStamp = expired[slot].load(memory_order_acquire);
+            slots[kept] = slot;
+            kept += created[slot] <= timestamp && (expiredStamp == 0 || expiredStamp > timestamp);
+        }
+        selection.resize(kept, 0);
+    }
+
+    // layout — пустые колонки с типами и словарями таблицы
+    void reset(const Vector<ColumnData>& layout)
+    {
+        columns = layout;
+        rows = 0;
+        capacity = 0;
+        created.reset();
+        expired.reset();
+        pendingCount = 0;
+        dead.clear();
+        deadCount = 0;
+    }
+    // Перевыделяет массивы; у опубликованного чанка вызывается только на его копии
+    void reserve(const int slots)
+    {
+        for (ColumnData& column: columns) {
+            column.reserve(slots);
+        }
+        copyStamps(*this, slots);
+    }
+    void copyStamps(const ChunkInfo& source, const int slots)
+    {
+        unique_ptr<uint64_t[]> createdStamps(new uint64_t[slots]());
+        unique_ptr<atomic<uint64_t>[]> expiredStamps(new atomic<uint64_t>[slots]());
+        for (int slot = 0; slot < min(source.rows, source.capacity); slot++) {
+            createdStamps[slot] = source.created[slot];
+            expiredStamps[slot].store(source.expiredAt(slot), memory_order_relaxed);
+        }
+        created = move(createdStamps);
+        expired = move(expiredStamps);
+        capacity = slots;
+    }
+    [[nodiscard]] shared_ptr<ChunkInfo> clone(const int slots) const
+    {
+        shared_ptr<ChunkInfo> copy = make_shared<ChunkInfo>();
+        copy->id = id;
+        copy->bytes = bytes;
+        copy->columns = columns;
+        for (ColumnData& column: copy->columns) {
+            column.reserve(slots);
+        }
+        copy->rows = rows;
+        copy->copyStamps(*this, slots);
+        copy->pendingCount = pendingCount;
+        copy->dead = dead;
+        copy->deadCount = deadCount;
+        copy->flushedRows = flushedRows;
+        copy->deadDirty = deadDirty;
+        copy->zone = zone;
+        return copy;
+    }
+    [[nodiscard]] bool needsDecode(const Vector<string>& row) const
+    {
+        for (size_t column = 0; column < columns.size() && column < row.size(); column++) {
+            if (columns[column].needsDecode(row[column])) {
+                return true;
+            }
+        }
+        return false;
+    }
+    // Недостающие поля строки дополняются пустыми значениями, лишние отбрасываются
+    void appendRow(Vector<string>&& row, const uint64_t stamp = 0)
+    {
+        if (rows >= capacity) {
+            reserve(max(16, rows * 2));
+        }
+        for (size_t column = 0; column < columns.size(); column++)
+        {
+            ColumnData& data = columns[column];
+            const bool wasEncoded = data.encoded();
+            if (column < row.size()) {
+                data.append(move(row[column]));
+            } else {
+                data.append(data.numeric() ? string("0") : string());
+            }
+            // Колонка перешла на строки: новый массив сразу выделяется на всю вместимость
+            if (wasEncoded && !data.encoded()) {
+                data.reserve(capacity);
+            }
+        }
+        created[rows] = stamp;
+        expired[rows].store(0, memory_order_relaxed);
+        dead.push_back(false);
+        rows++;
+    }
+    // Удаление, зафиксированное с меткой stamp; строка остаётся на месте для старых снимков
+    void expire(const size_t slot, const uint64_t stamp)
+    {
+        expired[slot].store(stamp, memory_order_release);
+        pendingCount++;
+        deadDirty = true;
+    }
+};
+
+// Строка чанка без копирования значений; живёт, пока чанк не меняется
+class RowView
+{
+private:
+    const ChunkInfo* chunk;
+    int slot;
+public:
+    RowView() : chunk(nullptr), slot(0) {}
+    RowView(const ChunkInfo& c, const int s) : chunk(&c), slot(s) {}
+
+    [[nodiscard]] string operator[](const size_t column) const {return chunk->value(column, slot);}
+    [[nodiscard]] const ColumnData& column(const size_t index) const {return chunk->columns[index];}
+    [[nodiscard]] int getSlot() const {return slot;}
+    [[nodiscard]] size_t size() const {return chunk->columns.size();}
+    [[nodiscard]] bool visible(const uint64_t timestamp) const {return chunk->visible(slot, timestamp);}
+    // Сравнение по типу колонки: числа — как числа, текст — как в упорядоченном индексе
+    [[nodiscard]] int compare(const size_t index, const RowView& other) const
+    {
+        const ColumnData& mine = column(index);
+        const ColumnData& theirs = other.column(index);
+        if (mine.numeric()) {
+            const int64_t left = mine.number(slot);
+            const int64_t right = theirs.number(other.slot);
+            return left < right ? -1 : left > right ? 1 : 0;
+        }
+        return OrderedKey::compare(mine.text(slot), theirs.text(other.slot));
+    }
+    [[nodiscard]] Vector<string> materialize() const
+    {
+        Vector<string> row;
+        row.reserve(size());
+        for (size_t column = 0; column < size(); column++) {
+            row.push_back((*this)[column]);
+        }
+        return row;
+    }
+};
+
+// Условие WHERE, переведённое в программу один раз на запрос: номера колонок найдены,
+// оператор стал кодом, литералы разобраны в тип колонки. Узлы лежат подряд в одном массиве:
+// левый операнд AND и OR идёт сразу за узлом, правый — по индексу operand
+class Predicate
+{
+public:
+    enum Opcode : uint8_t
+    {
+        ALWAYS,
+        NEVER,
+        AND,
+        OR,
+        // Колонка чанка против литерала: число, код словаря, строка
+        NUMBER,
+        CODE,
+        TEXT,
+        // Ячейка склеенной строки соединения против литерала или другой ячейки
+        CELL,
+        CELLS
+    };
+    enum Comparison : uint8_t {EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL};
+private:
+    struct Node
+    {
+        Opcode opcode = NEVER;
+        Comparison comparison = EQUAL;
+        // -1 у CELL и CELLS — пустое значение вместо отсутствующей колонки
+        int column = -1;
+        // AND и OR — индекс правого операнда, CELLS — вторая ячейка
+        int operand = -1;
+        // NUMBER — значение колонки, CODE — код в словаре dictionary
+        int64_t number = 0;
+        const Dictionary* dictionary = nullptr;
+        // Литерал в канонической записи и разобранный для сравнения диапазона
+        string text;
+        OrderedKey key;
+
+        Node() = default;
+        explicit Node(const Opcode code) : opcode(code) {}
+    };
+    Vector<Node> nodes;
+
+    static Comparison comparisonOf(const Condition& condition);
+    static bool accepts(Comparison comparison, int cmp);
+    int append(Node node);
+    void compileCondition(const Condition& condition, const Vector<ColumnData>& layout);
+    void compileJoinedCondition(const Condition& condition, const Vector<string>& headers);
+    template<typename Compile>
+    void compileList(const Vector<Condition*>& conditions, Opcode opcode, Compile&& compile);
+    [[nodiscard]] bool evaluate(int index, const RowView& row) const;
+    [[nodiscard]] bool evaluate(int index, const Vector<string_view>& row) const;
+    void filter(int index, const ChunkInfo& chunk, Vector<int>& selection) const;
+public:
+    // Условия уже привязаны к таблице; список понимается как OR, как в запросе к одной таблице
+    static Predicate compile(const Vector<Condition*>& conditions, const Vector<ColumnData>& layout);
+    // Условия над склеенной строкой соединения с колонками headers; список понимается как AND
+    static Predicate compileJoined(const Vector<Condition*>& conditions, const Vector<string>& headers);
+    [[nodiscard]] bool matches(const RowView& row) const {return evaluate(0, row);}
+    [[nodiscard]] bool matches(const Vector<string_view>& row) const {return evaluate(0, row);}
+    // Оставляет в векторе выбора слоты чанка, подходящие под условие; каждый узел
+    // проверяет всю пачку подряд по массиву своей колонки
+    void filter(const ChunkInfo& chunk, Vector<int>& selection) const {filter(0, chunk, selection);}
+};
+
+// Положение строки в резидентных чанках; chunk == -1 — ключа нет
+struct RowLocation
+{
+    int chunk = -1;
+    int slot = -1;
+};
+
+// Чанки, закреплённые снимком таблицы. Пока снимок жив, объекты чанков не освобождаются,
+// а строки, которые в них уже были, не меняются: очистка и перекодирование подменяют
+// чанк копией, новые строки дописываются за зафиксированной границей rows
+struct ChunkPin
+{
+    shared_ptr<const ChunkInfo> chunk;
+    int rows = 0;
+};
+
+class TableSnapshot
+{
+private:
+    uint64_t timestamp = 0;
+    Vector<ChunkPin> chunks;
+    friend class Table;
+public:
+    [[nodiscard]] uint64_t getTimestamp() const {return timestamp;}
+    // Обход видимых снимку строк без защёлки таблицы пачками до ChunkInfo::BATCH слотов:
+    // visit получает чанк и вектор выбора, который может сузить
+    template<typename Visitor>
+    void forEachBatch(Visitor&& visit) const
+    {
+        Vector<int> selection;
+        selection.reserve(ChunkInfo::BATCH);
+        for (const ChunkPin& pin: chunks) {
+            for (int begin = 0; begin < pin.rows; begin += ChunkInfo::BATCH)
+            {
+                pin.chunk->selectVisible(begin, min(pin.rows, begin + ChunkInfo::BATCH), timestamp, selection);
+                if (!selection.empty()) {
+                    visit(*pin.chunk, selection);
+                }
+            }
+        }
+    }
+};
+
+// Выборка из таблицы или партиции: то, что собрано под её защёлкой
+struct ScanPlan
+{
+    TableSnapshot pinned;
+    // Строки, найденные по индексам; при полном обходе проверяются все закреплённые чанки
+    Vector<RowView> candidates;
+    bool scan = false;
+    // Кандидаты уже идут в порядке ORDER BY
+    bool ordered = false;
+    // Обход чанков даёт строки не по возрастанию ключа (в таблице есть версии после UPDATE)
+    bool keysUnordered = false;
+    // Условия запроса, скомпилированные по привязке к этой таблице или партиции
+    Predicate predicate;
+};
+
+class Table;
+
+// Строка, которую меняет UPDATE: где лежит текущая версия и значения до и после правки
+struct RowRevision
+{
+    Table* source = nullptr;
+    RowLocation location;
+    Vector<string> before;
+    Vector<string> after;
+};
+
+// Строки COPY, разложенные по новым чанкам вне таблицы: таблица получает их
+// одной фиксацией, когда файлы чанков уже на диске
+struct BulkLoad
+{
+    Vector<shared_ptr<ChunkInfo>> chunks;
+    int nextId = 1;
+    // Чанки, файлы которых уже записаны
+    size_t written = 0;
+    size_t rows = 0;
+};
+
+// Индекс из schema.json: "hash" по одной или нескольким колонкам, "btree" по одной
+struct IndexDefinition
+{
+    Vector<string> columns;
+    string type = "hash";
+};
+
+struct TableOptions
+{
+    string format = "csv";
+    double vacuumThreshold = 0.5;
+    int pkCache = 100;
+    int lockTimeoutMs = 5000;
+    Vector<IndexDefinition> indexes;
+    Vector<string> bloomColumns;
+    Vector<string> dictionaryColumns;
+    // Типы колонок схемы по порядку; пустой список — все колонки TEXT
+    Vector<ColumnType> types;
+    // Хеш-партиционирование по колонке схемы; partitions <= 1 — таблица без партиций
+    string partitionColumn;
+    int partitions = 1;
+};
+
 class Table
 {
 private:
@@ -39,53 +534,302 @@ private:
     Vector<string> columns;
     string path;
     int tuplesLimit;
-    int PK = 1;
-    bool isLocked = false;
+    TableOptions options;
+    LockManager locks;
+    // Следующий выдаваемый ключ и сохранённая на диске граница зарезервированного блока
+    atomic<int> PK{1};
+    atomic<int> pkHighWater{1};
+    std::mutex pkMutex;
+    // Защёлка резидентных структур; логические блокировки строк — в locks.
+    // Читатели держат её только пока закрепляют чанки и обходят индексы
     mutable shared_mutex mutex;
+    // Очистка чанков и сборка старых версий не идут одновременно
+    std::mutex maintenanceMutex;
+    VersionClock ownClock;
+    VersionClock* clock = &ownClock;
+    Vector<shared_ptr<ChunkInfo>> chunks;
+    // Плотный индекс PK -> строка: ключи выдаются подряд, поэтому адресуется напрямую
+    Vector<RowLocation> pkIndex;
+    Vector<HashIndex*> indexes;
+    Vector<OrderedIndex*> orderedIndexes;
+    // Версии, которые UPDATE заменил новыми в этой же таблице и которые ещё не собраны.
+    // Пока они есть, ключ индекса может вести не к той версии, что видит снимок
+    int supersededRows = 0;
+    // Ключи легли в чанки не по возрастанию: новая версия строки дописывается в хвост
+    int highestKey = 0;
+    bool keysUnordered = false;
+    Vector<int> bloomPositions;
+    // Пустые колонки нового чанка: типы и словари (nullptr — без словаря); размер равен width()
+    Vector<ColumnData> layout;
+    WriteAheadLog* wal = nullptr;
+    // Партиционированная таблица сама строк не хранит: они лежат в партициях,
+    // а у партиции owner — таблица, которая выдаёт ключи всем партициям
+    Vector<Table*> partitions;
+    Table* owner = nullptr;
+    int partitionColumn = -1;
+    ColumnType partitionType;
+    // Партиция с числом строк от этого порога проверяется в отдельном потоке
+    static constexpr size_t PARALLEL_ROWS = 4096;
+    // Столько строк COPY копится на таблицу или партицию, прежде чем разложиться по чанкам
+    static constexpr size_t BULK_BATCH = 4096;
+    Table(Table& parent, int partition);
+    void open();
+    void openPartitions(const string& directory);
+    void migrateToPartitions(const string& directory);
+    void removeFlatFiles() const;
+    [[nodiscard]] int partitionOf(const string& value) const;
+    [[nodiscard]] Table* partitionFor(const Vector<string>& row) const;
+    void collectPartitions(const Condition& condition, const Vector<string>* references, Vector<bool>& possible) const;
+    // Таблицы, которые читает или меняет оператор: сама таблица или подходящие под условия партиции
+    [[nodiscard]] Vector<Table*> targetsFor(const Vector<Condition*>& conditions, const Vector<string>* references);
+    void planScan(ScanPlan& plan, const Vector<Condition*>& conditions, int orderIndex, bool descending) const;
+    void matchRows(const ScanPlan& plan, Vector<RowView>& matched);
+    // Строки партиций по возрастанию PK; sorted — единственная партиция уже отдала их в этом порядке
+    static Vector<RowView> inKeyOrder(Vector<Vector<RowView>>& matched, bool sorted);
+    [[nodiscard]] bool replacedAfter(const RowLocation& location, uint64_t timestamp) const;
+    void planFullScan(ScanPlan& plan, const Vector<Condition*>& conditions) const;
+    // predicate — условия, скомпилированные для этой таблицы; им же перепроверяются строки после блокировки
+    Vector<int> deleteCandidates(const Vector<Condition*>& conditions, Predicate& predicate);
+    // Последние версии кандидатов, которые всё ещё подходят под условие: их ключи и положение
+    void matchLiveRows(const Vector<int>& candidates, const Predicate& predicate,
+                       Vector<string>& keys, Vector<RowLocation>& locations) const;
+    void collectDeleted(const Vector<RowLocation>& deleted);
+    void replayRow(const Vector<string>& row);
+    void reviseRows(const Vector<int>& candidates, const Predicate& predicate,
+                    const Vector<Assignment>& assignments, Vector<RowRevision>& revisions);
+    bool readCopyHeader(const Vector<string_view>& fields, Vector<int>& positions) const;
+    void bulkAppend(BulkLoad& load, Vector<Vector<string>>& rows);
+    void writeBulk(BulkLoad& load, bool all);
+    void publishBulk(const BulkLoad& load, uint64_t stamp);
+    void discardBulk(const BulkLoad& load) const;
+    // Сбой посреди публикации COPY в партиции: их манифесты обрезаются до первых чанков загрузки
+    void rollbackCopy() const;
+    // Пустой чанк с выделенной вместимостью; файлы на диске не создаёт
+    [[nodiscard]] shared_ptr<ChunkInfo> newChunk(int id) const;
     Vector<Vector<string>> selectAll();
+    void loadRows();
+    void readCsvChunk(const string& filename, ChunkInfo& chunk);
+    void readBinaryChunk(const string& filename, ChunkInfo& chunk);
+    bool readColumnarChunk(ChunkInfo& chunk);
+    size_t writeBinaryRows(const string& filename, const ChunkInfo& chunk, size_t from, size_t to);
+    size_t writeColumnarRows(const ChunkInfo& chunk, size_t from, size_t to, const string& suffix);
+    void convertCsvChunks();
+    [[nodiscard]] shared_ptr<ChunkInfo> rewriteChunk(const ChunkInfo& chunk);
+    // previous — значения заменяемой версии той же строки: совпавшие записи индексов не дублируются
+    void appendRow(int key, Vector<string>&& row, uint64_t stamp, const Vector<string>* previous = nullptr);
+    void flushChunks();
+    void createIndexes();
+    void initZone(ChunkInfo& chunk) const;
+    void rebuildZone(ChunkInfo& chunk) const;
+    [[nodiscard]] bool chunkMayMatch(const ChunkInfo& chunk, const Condition& condition,
+                                     const Vector<string>* references) const;
+    void rebuildPkIndex();
+    void rebuildIndexes();
+    void indexRow(int key, int chunk, int slot);
+    [[nodiscard]] RowLocation locate(int key) const;
+    [[nodiscard]] RowView rowAt(const RowLocation& location) const {return {*chunks[location.chunk], location.slot};}
+    void markDead(const RowLocation& location);
+    // Вызывающий держит защёлку; conditions == nullptr — закрепить все чанки
+    void pinChunks(TableSnapshot& snapshot, const Vector<Condition*>* conditions,
+                   const Vector<string>* references) const;
+    static void collectComparisons(const Condition& condition, Vector<const Condition*>& comparisons);
+    static bool rangeFor(const OrderedIndex& index, const Vector<const Condition*>& comparisons,
+                         OrderedBound& low, OrderedBound& high);
+    bool collectKeys(const Condition& condition, Vector<int>& keys, bool useOrdered) const;
+    bool lookupKeys(const Vector<Condition*>& conditions, Vector<int>& keys, bool useOrdered = true) const;
+    [[nodiscard]] const OrderedIndex* orderedIndexOn(int column) const;
+    [[nodiscard]] bool isBinary() const {return options.format == "binary";}
+    [[nodiscard]] bool isColumnar() const {return options.format == "columnar";}
+    [[nodiscard]] size_t width() const {return columns.size() + 1;}
+    // Для колоночного чанка — файл колонки PK, по нему проверяется существование чанка
+    [[nodiscard]] string chunkPath(int id) const
+    {
+        if (isColumnar()) {
+            return columnPath(id, 0);
+        }
+        return path + "/" + to_string(id) + (isBinary() ? ".bin" : ".csv");
+    }
+    [[nodiscard]] string columnPath(int id, size_t column) const
+    {
+        return path + "/" + to_string(id) + ".c" + to_string(column);
+    }
+    [[nodiscard]] Vector<string> chunkFiles(int id) const;
+    [[nodiscard]] string csvChunkPath(int id) const {return path + "/" + to_string(id) + ".csv";}
+    [[nodiscard]] string deadMapPath(int id) const {return path + "/" + to_string(id) + ".del";}
+    [[nodiscard]] string zonePath(int id) const {return path + "/" + to_string(id) + ".zone";}
+    [[nodiscard]] string swapMarkerPath(int id) const {return path + "/" + to_string(id) + ".swap";}
+    [[nodiscard]] string manifestPath() const {return path + "/" + tableName + "_manifest";}
+    [[nodiscard]] string pkSequencePath() const {return path + "/" + tableName + "_pk_sequence";}
+    // Колонка и число партиций, на которые уже разложены данные таблицы
+    [[nodiscard]] string partitionLayoutPath() const {return path + "/" + tableName + "_partitions";}
+    [[nodiscard]] string partitionPath(const int partition) const {return path + "/p" + to_string(partition);}
+    // Пока файл существует, COPY в партиции не завершён: в нём первые чанки загрузки по партициям
+    [[nodiscard]] string copyMarkerPath() const {return path + "/" + tableName + "_copy";}
 public:
-    Table(const string& name, const Vector<string>& cols, const string& directory, const int limit)
+    // Для теста сбоя: вызывается после записи манифеста каждой партиции при публикации COPY
+    static inline void (*bulkPublishHook)(size_t partition) = nullptr;
+    Table(const string& name, const Vector<string>& cols, const string& directory, const int limit,
+          const TableOptions& opts = TableOptions())
     : tableName(name), columns(cols), path(directory + "/" + name)
-    , tuplesLimit(limit)
-    {
-        create_directories(path);
-        string firstFile = path + "/1.csv";
-        if (!exists(firstFile)) {
-            createNewFile();
-            writePK();
-            cout << "Table '" << name << "' created in " << path << endl;
+    , tuplesLimit(limit), options(opts), locks(name, opts.lockTimeoutMs)
+    {
+        if (options.format != "csv" && options.format != "binary" && options.format != "columnar") {
+            throw runtime_error("Неизвестный формат таблицы '" + name + "': " + options.format);
+        }
+        if (options.partitions > 1) {
+            openPartitions(directory);
         } else {
-            readPK();
-            cout << "Table '" << name << "' loaded from " << path << endl;
+            open();
+        }
+    }
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+    ~Table()
+    {
+        for (const Table* partition: partitions) {
+            delete partition;
+        }
+        for (const HashIndex* index: indexes) {
+            delete index;
+        }
+        for (const OrderedIndex* index: orderedIndexes) {
+            delete index;
+        }
+        for (const ColumnData& column: layout) {
+            delete column.dictionary;
         }
     }
-    void insertData(const Vector<string>& values);
-    Vector<Vector<string>> findData(const Vector<string>& headers, const Vector<Condition*>& conditions);
+    // Все строки вставляются одной фиксацией и одной записью журнала
+    void insertData(const Vector<Vector<string>>& rows);
+    void insertData(const Vector<string>& values) {insertData(Vector<Vector<string>>{values});}
+    Vector<Vector<string>> findData(const Vector<string>& headers, const Vector<Condition*>& conditions,
+                                    const string& orderColumn = "", bool descending = false);
     void deleteData(const Vector<Condition*>& conditions);
+    // Новая версия строки с тем же PK; прежняя остаётся открытым снимкам. Возвращает число строк
+    size_t updateData(const Vector<Assignment>& assignments, const Vector<Condition*>& conditions);
+    int vacuum();
+    void flush();
+    // Штатная остановка: на диск ложится точный следующий ключ, остаток блока возвращается.
+    // После сбоя последовательность по-прежнему продолжается с границы блока
+    void saveNextKey();
+    void replayInsert(const Vector<string>& fields);
+    void replayDelete(const Vector<string>& keys);
+    void replayUpdate(const Vector<string>& fields);
+    // Загрузка CSV-файла: строки без PK, по колонкам схемы или по заголовку. Возвращает число строк.
+    // Ошибки называют номер строки и колонку, но не путь и не значения из файла
+    size_t copyFrom(const string& filename);
+    void setWal(WriteAheadLog* log)
+    {
+        wal = log;
+        for (Table* partition: partitions) {
+            partition->setWal(log);
+        }
+    }
+    void setClock(VersionClock* versions)
+    {
+        clock = versions;
+        for (Table* partition: partitions) {
+            partition->setClock(versions);
+        }
+    }
+    // Переводит в dead удалённые не позже horizon строки и убирает их из индексов
+    int collectGarbage(uint64_t horizon);
+    // Строки таблицы для соединения в снимке timestamp: подходящие под conditions, по возрастанию PK.
+    // references — колонки всех таблиц соединения; joinConditions проверит соединение
+    [[nodiscard]] Vector<Vector<string>> joinRows(uint64_t timestamp, const Vector<Condition*>& conditions,
+                                                  const Vector<Condition*>& joinConditions,
+                                                  const Vector<string>& references);
 
     string createNewFile();
-    void writeDataToFile(const string& filename, const Vector<string>& values);
+    size_t writeChunkHeader(int id, const string& suffix = "") const;
+    size_t writeDataToFile(const ChunkInfo& chunk, size_t from, size_t to, const string& suffix = "");
+    void syncChunkFiles(int id, const string& suffix = "") const;
+    void removeChunkFiles(int id) const;
+    void swapChunkFiles(int id) const;
+    void finishChunkSwap(int id) const;
+    void recoverChunkSwap(int id) const;
+    // Файл заменяется целиком: новое содержимое пишется в .tmp, сбрасывается на диск и
+    // переименовывается поверх старого, так что после сбоя на месте остаётся одна из версий
+    static void replaceFile(const string& filename, const string& contents);
     void readPK();
     void writePK();
-    void resetPK(){PK = 1; writePK();}
+    void readManifest();
+    void writeManifest();
+    void readDeadMap(ChunkInfo& chunk);
+    void writeDeadMap(const ChunkInfo& chunk);
+    bool readZoneMap(ChunkInfo& chunk) const;
+    void writeZoneMap(const ChunkInfo& chunk) const;
+    int nextPK();
+    // Первый из count подряд идущих ключей
+    int reserveKeys(int count);
+    // Возвращает невыданные ключи [from, to) последнего зарезервированного блока
+    void releaseKeys(int from, int to);
+    void raisePK(int next);
+    // Последовательность новой таблицы; опустевшая таблица её не сбрасывает — выданный ключ
+    // мог остаться в журнале или в строках других таблиц
+    void resetPK();
 
-    void lockTable();
-    void unlockTable();
-    bool isTableBlocked();
+    // У партиционированной таблицы — сумма по блокировкам партиций
+    [[nodiscard]] LockStats lockStats() const;
 
-    bool checkWhere(const Vector<Condition*>& conditions, const Vector<string>& row);
-    bool checkCondition(const Condition& condition, const Vector<string>& row);
+    // references — имена колонок, которые в соединении стоят справа от оператора вместо значения
+    void bindConditions(const Vector<Condition*>& conditions, const Vector<string>* references = nullptr) const;
+    void bindCondition(const Condition& condition, const Vector<string>* references) const;
     [[nodiscard]] Vector<int> getColumnIndexes(const Vector<string>& headers) const;
     [[nodiscard]] Vector<string> getAllColumns(const string& tableName) const;
+    [[nodiscard]] int getColumnIndex(string_view column) const;
+    // PK из записи значения; -1 — не ключ
+    static int parseKey(const string& value);
     static Vector<string> splitLine(const string& line);
+    static void splitLine(string_view line, Vector<string_view>& fields);
     Vector<Vector<string>> selectAllSafe()
     {
         shared_lock<shared_mutex> lock(mutex);
         return selectAll();
     }
+    // Обход последних версий резидентных строк без копирования; вызывающий держит защёлку
+    template<typename Visitor>
+    void forEachRow(Visitor&& visit) const
+    {
+        for (const shared_ptr<ChunkInfo>& chunk: chunks) {
+            for (int slot = 0; slot < chunk->rowCount(); slot++) {
+                if (chunk->isLive(slot)) {
+                    visit(RowView(*chunk, slot));
+                }
+            }
+        }
+    }
+    // references — имена колонок, которые в соединении стоят справа от оператора вместо значения
+    [[nodiscard]] bool chunkMayMatch(const ChunkInfo& chunk, const Vector<Condition*>& conditions,
+                                     const Vector<string>* references = nullptr) const;
+    // Последние версии строк пачками, как TableSnapshot::forEachBatch, без чанков,
+    // которые по своей сводке не могут подойти под conditions
+    template<typename Visitor>
+    void forEachBatchMatching(const Vector<Condition*>& conditions, const Vector<string>* references, Visitor&& visit) const
+    {
+        Vector<int> selection;
+        selection.reserve(ChunkInfo::BATCH);
+        for (const shared_ptr<ChunkInfo>& chunk: chunks)
+        {
+            if (!chunkMayMatch(*chunk, conditions, references)) {
+                continue;
+            }
+            for (int begin = 0; begin < chunk->rowCount(); begin += ChunkInfo::BATCH)
+            {
+                chunk->selectVisible(begin, min(chunk->rowCount(), begin + ChunkInfo::BATCH), UINT64_MAX, selection);
+                if (!selection.empty()) {
+                    visit(*chunk, selection);
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] size_t rowCount() const;
+    [[nodiscard]] size_t memoryUsage() const;
 
     Vector<string> getColumns(){return columns;};
     string getPath(){return path;};
+    string getName(){return tableName;};
 };
 
 #endif //TABLE_H
@@ -17,7 +17,7 @@ private:
         T* new_data = new T[new_capacity];
         
         for (size_t i = 0; i < vec_size; i++) {
-            new_data[i] = data[i];
+            new_data[i] = move(data[i]);
         }
         
         delete[] data;
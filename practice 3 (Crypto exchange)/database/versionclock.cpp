@@ -0,0 +1,44 @@
+#include "versionclock.h"
+
+uint64_t VersionClock::open()
+{
+    // Метка читается под той же блокировкой, что и горизонт: сборщик не удалит
+    // версию, которую снимок ещё успеет увидеть
+    lock_guard<mutex> lock(snapshotMutex);
+    const uint64_t timestamp = visible.load();
+    active.push_back(timestamp);
+    return timestamp;
+}
+
+void VersionClock::publish(const uint64_t stamp)
+{
+    uint64_t shown = visible.load();
+    while (shown < stamp && !visible.compare_exchange_weak(shown, stamp)) {}
+}
+
+void VersionClock::close(const uint64_t timestamp)
+{
+    lock_guard<mutex> lock(snapshotMutex);
+    for (uint64_t* it = active.begin(); it != active.end(); ++it) {
+        if (*it == timestamp) {
+            active.erase(it);
+            return;
+        }
+    }
+}
+
+uint64_t VersionClock::horizon() const
+{
+    lock_guard<mutex> lock(snapshotMutex);
+    uint64_t oldest = visible.load();
+    for (const uint64_t timestamp: active) {
+        oldest = min(oldest, timestamp);
+    }
+    return oldest;
+}
+
+int VersionClock::openSnapshots() const
+{
+    lock_guard<mutex> lock(snapshotMutex);
+    return static_cast<int>(active.size());
+}
@@ -0,0 +1,61 @@
+#ifndef VERSIONCLOCK_H
+#define VERSIONCLOCK_H
+#include "vector.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+using namespace std;
+
+// Часы фиксаций базы. Вставка и удаление строки помечаются меткой фиксации,
+// читатель берёт метку снимка и видит ровно те версии, что зафиксированы не позже неё.
+// Открытые снимки регистрируются: версии старше самого раннего из них никому не нужны
+class VersionClock
+{
+private:
+    atomic<uint64_t> current{1};
+    // Последняя метка, открытая снимкам. С журналом она отстаёт от current,
+    // пока записи изменений не сброшены на диск
+    atomic<uint64_t> visible{1};
+    mutable mutex snapshotMutex;
+    Vector<uint64_t> active;
+public:
+    VersionClock() = default;
+    VersionClock(const VersionClock&) = delete;
+    VersionClock& operator=(const VersionClock&) = delete;
+
+    // Метка очередной фиксации, сразу видимая снимкам: без журнала и при восстановлении.
+    // Вызывается под исключительной защёлкой таблицы
+    uint64_t commit()
+    {
+        const uint64_t stamp = reserve();
+        publish(stamp);
+        return stamp;
+    }
+    // Метка фиксации, которую снимки увидят только после publish
+    uint64_t reserve() {return current.fetch_add(1) + 1;}
+    // Метки до stamp включительно становятся видны новым снимкам
+    void publish(uint64_t stamp);
+    uint64_t open();
+    void close(uint64_t timestamp);
+    // Удалённые не позже этой метки версии не видны ни одному снимку
+    [[nodiscard]] uint64_t horizon() const;
+    [[nodiscard]] int openSnapshots() const;
+};
+
+// Снимок одного запроса: метка выдаётся при создании и освобождается в деструкторе
+class ReadSnapshot
+{
+private:
+    VersionClock* clock;
+    uint64_t stamp;
+public:
+    explicit ReadSnapshot(VersionClock& versions) : clock(&versions), stamp(versions.open()) {}
+    ReadSnapshot(const ReadSnapshot&) = delete;
+    ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+
+    [[nodiscard]] uint64_t timestamp() const {return stamp;}
+
+    ~ReadSnapshot() {clock->close(stamp);}
+};
+
+#endif //VERSIONCLOCK_H
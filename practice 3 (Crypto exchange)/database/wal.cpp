@@ -0,0 +1,192 @@
+#include "wal.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+WriteAheadLog::WriteAheadLog(const string& file, VersionClock& versions) : filename(file), clock(&versions)
+{
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+        throw runtime_error("Не удалось открыть журнал " + filename);
+    }
+    flusher = thread(&WriteAheadLog::flushLoop, this);
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    {
+        lock_guard<mutex> lock(walMutex);
+        stopping = true;
+    }
+    flushWakeup.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    close(fd);
+}
+
+uint64_t WriteAheadLog::append(const char type, const string& table, const Vector<string>& fields, uint64_t& stamp)
+{
+    string record(1, type);
+    record += " " + table + " " + to_string(fields.size());
+    for (const string& field: fields) {
+        record += " " + to_string(field.size()) + ":" + field;
+    }
+    record += "\n";
+
+    lock_guard<mutex> lock(walMutex);
+    pending += record;
+    const uint64_t lsn = nextLsn++;
+    stamp = clock->reserve();
+    lastStamp = stamp;
+    flushWakeup.notify_one();
+    return lsn;
+}
+
+uint64_t WriteAheadLog::reserveStamp(uint64_t& stamp)
+{
+    lock_guard<mutex> lock(walMutex);
+    stamp = clock->reserve();
+    lastStamp = stamp;
+    const uint64_t lsn = nextLsn - 1;
+    if (durableLsn == lsn) {
+        clock->publish(stamp);
+    }
+    return lsn;
+}
+
+void WriteAheadLog::waitDurable(const uint64_t lsn)
+{
+    unique_lock<mutex> lock(walMutex);
+    durableWakeup.wait(lock, [this, lsn] { return durableLsn >= lsn || !failure.empty(); });
+    if (durableLsn < lsn && !failure.empty()) {
+        throw runtime_error(failure);
+    }
+}
+
+void WriteAheadLog::sync()
+{
+    uint64_t lsn;
+    {
+        lock_guard<mutex> lock(walMutex);
+        lsn = nextLsn - 1;
+    }
+    flushWakeup.notify_one();
+    waitDurable(lsn);
+}
+
+bool WriteAheadLog::writeAll(const string& data) const
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result == -1) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+void WriteAheadLog::flushLoop()
+{
+    unique_lock<mutex> lock(walMutex);
+    while (true)
+    {
+        flushWakeup.wait(lock, [this] { return !pending.empty() || stopping; });
+        if (pending.empty() && stopping) {
+            break;
+        }
+        // Все записи, накопившиеся к этому моменту, уходят на диск одной пачкой
+        string batch;
+        batch.swap(pending);
+        const uint64_t batchLsn = nextLsn - 1;
+        const uint64_t batchStamp = lastStamp;
+        const bool failed = !failure.empty();
+        lock.unlock();
+        // После ошибки пачки не пишутся: при восстановлении следующая применилась бы
+        // без пропущенной. Неудачный fdatasync не повторяется — страницы могли быть уже потеряны
+        bool durable = false;
+        int error = 0;
+        if (!failed)
+        {
+            durable = writeAll(batch) && fdatasync(fd) == 0;
+            error = durable ? 0 : errno;
+        }
+        lock.lock();
+        if (durable)
+        {
+            durableLsn = batchLsn;
+            // Если новых записей не появилось, открываются и метки, выданные после пачки без записи
+            clock->publish(nextLsn - 1 == batchLsn ? lastStamp : batchStamp);
+        } else if (failure.empty()) {
+            failure = "Не удалось сохранить журнал " + filename + ": " + strerror(error) +
+                      ". Изменение не подтверждено, запись в базу возобновится после перезапуска";
+        }
+        durableWakeup.notify_all();
+    }
+}
+
+void WriteAheadLog::truncate()
+{
+    lock_guard<mutex> lock(walMutex);
+    if (!pending.empty()) {
+        throw runtime_error("Нельзя очистить журнал с несброшенными записями");
+    }
+    if (!failure.empty()) {
+        throw runtime_error(failure);
+    }
+    if (ftruncate(fd, 0) != 0 || fdatasync(fd) != 0) {
+        throw runtime_error("Не удалось очистить журнал " + filename + ": " + strerror(errno));
+    }
+}
+
+Vector<WalRecord> WriteAheadLog::readAll() const
+{
+    Vector<WalRecord> records;
+    ifstream file(filename, ios::binary);
+    while (file.peek() != EOF)
+    {
+        WalRecord record;
+        size_t count = 0;
+        if (!(file >> record.type >> record.table >> count)) {
+            break;
+        }
+        bool complete = true;
+        for (size_t i = 0; i < count && complete; i++)
+        {
+            size_t length = 0;
+            char separator = 0;
+            if (!(file >> length) || !file.get(separator) || separator != ':') {
+                complete = false;
+                break;
+            }
+            string field(length, '\0');
+            complete = static_cast<bool>(file.read(field.data(), length));
+            record.fields.push_back(move(field));
+        }
+        // Оборванная при сбое последняя запись не применяется
+        if (!complete || file.get() != '\n') {
+            break;
+        }
+        records.push_back(move(record));
+    }
+    return records;
+}
+
+void WriteAheadLog::syncFile(const string& file)
+{
+    const int fileFd = open(file.c_str(), O_RDONLY);
+    if (fileFd != -1) {
+        fsync(fileFd);
+        close(fileFd);
+    }
+}
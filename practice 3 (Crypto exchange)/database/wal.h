@@ -0,0 +1,75 @@
+#ifndef WAL_H
+#define WAL_H
+#include "vector.h"
+#include "versionclock.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+using namespace std;
+
+struct WalRecord
+{
+    char type = 0;
+    string table;
+    Vector<string> fields;
+};
+
+// Журнал упреждающей записи базы: логические INSERT/DELETE/UPDATE дописываются в буфер,
+// отдельный поток сбрасывает накопленную пачку одним fdatasync (group commit).
+// Метки фиксации выдаются вместе с номерами записей и открываются снимкам, когда пачка
+// на диске: читатель не увидит изменение, которое пропадёт при сбое
+class WriteAheadLog
+{
+private:
+    string filename;
+    int fd = -1;
+    VersionClock* clock;
+    mutex walMutex;
+    condition_variable flushWakeup;
+    condition_variable durableWakeup;
+    string pending;
+    uint64_t nextLsn = 1;
+    uint64_t durableLsn = 0;
+    // Последняя выданная метка фиксации; метки растут вместе с номерами записей
+    uint64_t lastStamp = 0;
+    bool stopping = false;
+    // Ошибка записи или fdatasync: после неё журнал не дописывается, а ожидающие её получают
+    string failure;
+    shared_mutex checkpointMutex;
+    thread flusher;
+    void flushLoop();
+    [[nodiscard]] bool writeAll(const string& data) const;
+public:
+    static constexpr char INSERT = 'I';
+    static constexpr char DELETE = 'D';
+    // Новые версии строк: PK и все колонки, строки подряд
+    static constexpr char UPDATE = 'U';
+
+    WriteAheadLog(const string& file, VersionClock& versions);
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    ~WriteAheadLog();
+
+    // Дописывает запись и выдаёт метку фиксации изменения; вызывается под исключительной защёлкой таблицы
+    uint64_t append(char type, const string& table, const Vector<string>& fields, uint64_t& stamp);
+    // Метка изменения без записи в журнале (данные COPY уже на диске). Она открывается вместе
+    // со всеми записями до неё; возвращает номер записи, которого стоит дождаться
+    uint64_t reserveStamp(uint64_t& stamp);
+    // Бросает исключение, если запись с этим номером не удалось сбросить на диск
+    void waitDurable(uint64_t lsn);
+    void sync();
+    void truncate();
+    Vector<WalRecord> readAll() const;
+
+    // Писатели держат разделяемую блокировку на время изменения таблицы и записи в журнал,
+    // контрольная точка - исключительную
+    shared_lock<shared_mutex> enter() {return shared_lock<shared_mutex>(checkpointMutex);}
+    unique_lock<shared_mutex> checkpointLock() {return unique_lock<shared_mutex>(checkpointMutex);}
+
+    static void syncFile(const string& file);
+};
+
+#endif //WAL_H
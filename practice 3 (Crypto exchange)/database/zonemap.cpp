@@ -0,0 +1,231 @@
+#include "zonemap.h"
+#include <sstream>
+
+uint64_t BloomFilter::hash(const string_view value, const uint64_t seed)
+{
+    // FNV-1a: фильтры сохраняются на диск, поэтому хеш не должен зависеть от реализации std::hash
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    for (const char c: value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void BloomFilter::init(const size_t bits)
+{
+    words.clear();
+    words.resize((bits + 63) / 64, 0);
+}
+
+void BloomFilter::add(const string_view value)
+{
+    const uint64_t bits = words.size() * 64;
+    const uint64_t first = hash(value, 0);
+    const uint64_t second = hash(value, first) | 1;
+    for (int i = 0; i < HASHES; i++) {
+        const uint64_t bit = (first + i * second) % bits;
+        words[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool BloomFilter::mayContain(const string_view value) const
+{
+    if (words.empty()) {
+        return true;
+    }
+    const uint64_t bits = words.size() * 64;
+    const uint64_t first = hash(value, 0);
+    const uint64_t second = hash(value, first) | 1;
+    for (int i = 0; i < HASHES; i++) {
+        const uint64_t bit = (first + i * second) % bits;
+        if (!(words[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ZoneMap::init(const int columns, const Vector<int>& filteredColumns, const size_t bloomBits)
+{
+    rows = 0;
+    columnCount = columns;
+    minValues.clear();
+    maxValues.clear();
+    minKeys.clear();
+    maxKeys.clear();
+    minValues.resize(columns, string());
+    maxValues.resize(columns, string());
+    minKeys.resize(columns, OrderedKey());
+    maxKeys.resize(columns, OrderedKey());
+    bloomColumns = filteredColumns;
+    blooms.clear();
+    blooms.resize(bloomColumns.size(), BloomFilter());
+    for (BloomFilter& bloom: blooms) {
+        bloom.init(bloomBits);
+    }
+}
+
+void ZoneMap::addValue(const int column, const string& value)
+{
+    const OrderedKey key = OrderedKey::parse(value);
+    if (rows == 0 || OrderedKey::compare(key, minKeys[column]) < 0) {
+        minKeys[column] = key;
+        minValues[column] = value;
+    }
+    if (rows == 0 || OrderedKey::compare(key, maxKeys[column]) > 0) {
+        maxKeys[column] = key;
+        maxValues[column] = value;
+    }
+    for (size_t i = 0; i < bloomColumns.size(); i++) {
+        if (bloomColumns[i] == column) {
+            blooms[i].add(value);
+        }
+    }
+}
+
+bool ZoneMap::hasLayout(const int columns, const Vector<int>& filteredColumns) const
+{
+    if (columns != columnCount || filteredColumns.size() != bloomColumns.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bloomColumns.size(); i++) {
+        if (bloomColumns[i] != filteredColumns[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const BloomFilter* ZoneMap::bloomFor(const int column) const
+{
+    for (size_t i = 0; i < bloomColumns.size(); i++) {
+        if (bloomColumns[i] == column) {
+            return &blooms[i];
+        }
+    }
+    return nullptr;
+}
+
+bool ZoneMap::mayEqual(const int column, const string_view value) const
+{
+    if (rows == 0) {
+        return false;
+    }
+    if (column < 0 || column >= columnCount) {
+        return true;
+    }
+    const OrderedKey key = OrderedKey::parse(value);
+    if (OrderedKey::compare(key, minKeys[column]) < 0 || OrderedKey::compare(key, maxKeys[column]) > 0) {
+        return false;
+    }
+    const BloomFilter* bloom = bloomFor(column);
+    return bloom == nullptr || bloom->mayContain(value);
+}
+
+bool ZoneMap::mayOverlap(const int column, const OrderedBound& low, const OrderedBound& high) const
+{
+    if (rows == 0) {
+        return false;
+    }
+    if (column < 0 || column >= columnCount) {
+        return true;
+    }
+    if (low.set) {
+        const int cmp = OrderedKey::compare(maxKeys[column], low.key);
+        if (cmp < 0 || (cmp == 0 && !low.inclusive)) {
+            return false;
+        }
+    }
+    if (high.set) {
+        const int cmp = OrderedKey::compare(minKeys[column], high.key);
+        if (cmp > 0 || (cmp == 0 && !high.inclusive)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ZoneMap::memoryUsage() const
+{
+    size_t bytes = columnCount * 2 * (sizeof(string) + sizeof(OrderedKey));
+    for (int column = 0; column < columnCount; column++) {
+        bytes += minValues[column].capacity() + maxValues[column].capacity();
+    }
+    for (const BloomFilter& bloom: blooms) {
+        bytes += sizeof(BloomFilter) + bloom.memoryUsage();
+    }
+    return bytes;
+}
+
+string ZoneMap::serialize(const int deadRows) const
+{
+    ostringstream out;
+    out << "rows " << rows << " dead " << deadRows << " columns " << columnCount << "\n";
+    for (int column = 0; column < columnCount; column++) {
+        out << minValues[column].size() << " " << maxValues[column].size() << " "
+            << minValues[column] << maxValues[column] << "\n";
+    }
+    out << "blooms " << blooms.size() << "\n";
+    for (size_t i = 0; i < blooms.size(); i++)
+    {
+        out << bloomColumns[i] << " " << blooms[i].words.size();
+        for (const uint64_t word: blooms[i].words) {
+            out << " " << word;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+bool ZoneMap::deserialize(const string& data)
+{
+    istringstream in(data);
+    string label;
+    int storedRows = 0;
+    int deadRows = 0;
+    int columns = 0;
+    if (!(in >> label >> storedRows) || label != "rows" || !(in >> label >> deadRows >> label >> columns) || columns <= 0) {
+        return false;
+    }
+    init(columns, Vector<int>(), 0);
+    in.get();
+    for (int column = 0; column < columns; column++)
+    {
+        size_t minSize = 0, maxSize = 0;
+        if (!(in >> minSize >> maxSize) || in.get() != ' ') {
+            return false;
+        }
+        string values(minSize + maxSize, '\0');
+        if (!in.read(values.data(), static_cast<streamsize>(values.size())) || in.get() != '\n') {
+            return false;
+        }
+        minValues[column] = values.substr(0, minSize);
+        maxValues[column] = values.substr(minSize);
+        minKeys[column] = OrderedKey::parse(minValues[column]);
+        maxKeys[column] = OrderedKey::parse(maxValues[column]);
+    }
+    size_t bloomCount = 0;
+    if (!(in >> label >> bloomCount) || label != "blooms") {
+        return false;
+    }
+    for (size_t i = 0; i < bloomCount; i++)
+    {
+        int column = 0;
+        size_t wordCount = 0;
+        if (!(in >> column >> wordCount)) {
+            return false;
+        }
+        BloomFilter bloom;
+        bloom.words.resize(wordCount, 0);
+        for (size_t w = 0; w < wordCount; w++) {
+            if (!(in >> bloom.words[w])) {
+                return false;
+            }
+        }
+        bloomColumns.push_back(column);
+        blooms.push_back(bloom);
+    }
+    rows = storedRows;
+    return true;
+}
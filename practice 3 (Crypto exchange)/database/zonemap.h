@@ -0,0 +1,61 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+#include "orderedindex.h"
+#include "vector.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+using namespace std;
+
+class BloomFilter
+{
+private:
+    Vector<uint64_t> words;
+    static constexpr int HASHES = 4;
+    static uint64_t hash(string_view value, uint64_t seed);
+public:
+    void init(size_t bits);
+    void add(string_view value);
+    [[nodiscard]] bool mayContain(string_view value) const;
+    [[nodiscard]] size_t memoryUsage() const {return words.size() * sizeof(uint64_t);}
+
+    friend class ZoneMap;
+};
+
+// Сводка чанка: min/max каждой колонки и bloom-фильтры выбранных колонок.
+// Удаления её не сужают, поэтому она остаётся верхней оценкой до перезаписи чанка
+class ZoneMap
+{
+private:
+    int rows = 0;
+    int columnCount = 0;
+    Vector<string> minValues;
+    Vector<string> maxValues;
+    Vector<OrderedKey> minKeys;
+    Vector<OrderedKey> maxKeys;
+    Vector<int> bloomColumns;
+    Vector<BloomFilter> blooms;
+    [[nodiscard]] const BloomFilter* bloomFor(int column) const;
+public:
+    void init(int columns, const Vector<int>& filteredColumns, size_t bloomBits);
+    template<typename Row>
+    void add(const Row& row)
+    {
+        for (int column = 0; column < columnCount && column < row.size(); column++) {
+            addValue(column, row[column]);
+        }
+        rows++;
+    }
+    void addValue(int column, const string& value);
+    [[nodiscard]] bool isInitialized() const {return columnCount > 0;}
+    [[nodiscard]] bool hasLayout(int columns, const Vector<int>& filteredColumns) const;
+    [[nodiscard]] int rowCount() const {return rows;}
+    [[nodiscard]] bool mayEqual(int column, string_view value) const;
+    [[nodiscard]] bool mayOverlap(int column, const OrderedBound& low, const OrderedBound& high) const;
+    [[nodiscard]] size_t memoryUsage() const;
+
+    [[nodiscard]] string serialize(int deadRows) const;
+    bool deserialize(const string& data);
+};
+
+#endif //ZONEMAP_H
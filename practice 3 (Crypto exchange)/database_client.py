@@ -1,3 +1,4 @@
+import re
 import socket
 
 
@@ -7,6 +8,9 @@ class DatabaseClient:
         self.port = port
 
     def execute_query(self, sql):
+        return self._parse_response(self._send(sql))
+
+    def _send(self, sql):
         s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
 
         try:
@@ -29,7 +33,7 @@ class DatabaseClient:
 
         s.sendall(b"EXIT")
         s.close()
-        return self._parse_response(buffer)
+        return buffer
 
     def _parse_response(self, response_text):
         response_text = response_text.strip()
@@ -81,7 +85,9 @@ class DatabaseClient:
         result = self.execute_query(sql)
         return result is True
 
-
-
-
-
+    def execute_update(self, sql):
+        response = self._send(sql).strip()
+        if response.startswith("ERROR"):
+            raise Exception(response)
+        match = re.search(r"строк: (\d+)", response)
+        return int(match.group(1)) if match else 0
@@ -2,6 +2,10 @@ from decimal import Decimal
 import uuid
 import time
 
+def sql_number(value):
+    # Десятичная запись без показателя: str(Decimal) даёт 1E-8, а сервер сравнивает и считает по записи
+    return format(Decimal(str(value)), 'f')
+
 class Exchange:
     def __init__(self, db_client, config):
         self.db_client = db_client
@@ -9,18 +13,18 @@ class Exchange:
 
     def initialize(self):
         res = self.db_client.execute_select("SELECT lot.name FROM lot")
-        if not res:
-            for lot_name in self.config['lots']:
-                self.db_client.execute_insert(f"INSERT INTO lot VALUES ('{lot_name}')")
+        if not res and self.config['lots']:
+            values = ", ".join(f"('{lot_name}')" for lot_name in self.config['lots'])
+            self.db_client.execute_insert(f"INSERT INTO lot VALUES {values}")
 
         lots = self.db_client.execute_select("SELECT lot_pk, lot.name FROM lot")
         exist_pairs = self.db_client.execute_select("SELECT pair_pk FROM pair")
 
         if not exist_pairs:
-            for lot1 in lots:
-                for lot2 in lots:
-                    if lot1['lot_pk'] != lot2['lot_pk']:
-                        self.db_client.execute_insert(f"INSERT INTO pair VALUES ({lot1['lot_pk']}, {lot2['lot_pk']})")
+            pairs = [f"({lot1['lot_pk']}, {lot2['lot_pk']})"
+                     for lot1 in lots for lot2 in lots if lot1['lot_pk'] != lot2['lot_pk']]
+            if pairs:
+                self.db_client.execute_insert(f"INSERT INTO pair VALUES {', '.join(pairs)}")
 
     def create_user(self, username):
         key = uuid.uuid4().hex
@@ -30,9 +34,9 @@ class Exchange:
         user_id = user_data[0]['user_pk']
 
         lots = self.db_client.execute_select("SELECT lot_pk FROM lot")
-        for lot in lots:
-            lot_id = lot['lot_pk']
-            self.db_client.execute_insert(f"INSERT INTO user_lot VALUES ({user_id}, {lot_id}, 1000)")
+        if lots:
+            values = ", ".join(f"({user_id}, {lot['lot_pk']}, 1000)" for lot in lots)
+            self.db_client.execute_insert(f"INSERT INTO user_lot VALUES {values}")
         return key
 
     def get_user_by_key(self, key):
@@ -82,22 +86,18 @@ class Exchange:
         else:
             raise Exception("Неверный тип ордера")
 
-        balance = self.db_client.execute_select(f'SELECT user_lot.quantity FROM user_lot WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_to_check}')
-        if not balance:
-            raise Exception("Недостаточно средств")
-
-        cur_balance = Decimal(balance[0]['user_lot.quantity'])
-        if cur_balance < amount_needed:
-            raise Exception(f"Недостаточно средств. Нужно: {amount_needed}, доступно: {cur_balance}")
-
-        new_balance = cur_balance - amount_needed
-        self.db_client.execute_delete(f'DELETE FROM user_lot WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_to_check}')
-        self.db_client.execute_insert(f'INSERT INTO user_lot VALUES ({user_id}, {lot_to_check}, {str(new_balance)})')
+        amount_sql = sql_number(amount_needed)
+        reserved = self.db_client.execute_update(f'UPDATE user_lot SET quantity = quantity - {amount_sql} WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_to_check} AND user_lot.quantity >= {amount_sql}')
+        if reserved == 0:
+            balance = self.db_client.execute_select(f'SELECT user_lot.quantity FROM user_lot WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_to_check}')
+            if not balance:
+                raise Exception("Недостаточно средств")
+            raise Exception(f"Недостаточно средств. Нужно: {amount_needed}, доступно: {balance[0]['user_lot.quantity']}")
 
         remain_quantity = self._match_orders(user_id, pair_id, quantity, price, order_type, first_lot_id, second_lot_id)
 
         if Decimal(remain_quantity) > 0:
-            self.db_client.execute_insert(f'INSERT INTO order VALUES ({user_id}, {pair_id}, {remain_quantity}, {str(price)}, "{order_type}", "")')
+            self.db_client.execute_insert(f'INSERT INTO order VALUES ({user_id}, {pair_id}, {sql_number(remain_quantity)}, {sql_number(price)}, "{order_type}", "")')
             orders = self.db_client.execute_select(f'SELECT order_pk FROM order WHERE order.user_id = {user_id} AND order.closed = ""')
             return orders[-1]['order_pk']
 
@@ -112,11 +112,12 @@ class Exchange:
         else:
             opposite_type = "sell"
 
-        orders = self.db_client.execute_select(f"SELECT order_pk, order.user_id, order.quantity, order.price FROM order WHERE order.pair_id = {pair_id} AND order.type = '{opposite_type}' AND order.closed = ''")
         if order_type == "buy":
-            orders.sort(key=lambda x: Decimal(x['order.price']))
+            price_filter, direction = f"order.price <= {price}", "ASC"
         else:
-            orders.sort(key=lambda x: Decimal(x['order.price']), reverse=True)
+            price_filter, direction = f"order.price >= {price}", "DESC"
+
+        orders = self.db_client.execute_select(f"SELECT order_pk, order.user_id, order.quantity, order.price FROM order WHERE order.pair_id = {pair_id} AND order.type = '{opposite_type}' AND order.closed = '' AND {price_filter} ORDER BY order.price {direction}")
 
         for cur_order in orders:
             cur_price = Decimal(cur_order['order.price'])
@@ -138,7 +139,7 @@ class Exchange:
             if new_cur_quantity == 0:
                 self._close_order(cur_order_id)
             else:
-                self._update_order_quantity(cur_order_id, str(new_cur_quantity))
+                self._update_order_quantity(cur_order_id, sql_number(new_cur_quantity))
 
             quantity -= possible_quantity
 
@@ -165,44 +166,19 @@ class Exchange:
         self._update_balance(seller, second_lot_id, total_cost, add=True)
 
     def _update_balance(self, user_id, lot_id, amount, add=True):
-        result = self.db_client.execute_select(f'SELECT user_lot.quantity FROM user_lot WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_id}')
-
-        if not result:
-            current = Decimal("0")
-        else:
-            current = Decimal(result[0]['user_lot.quantity'])
-
-        if add:
-            new_balance = current + Decimal(str(amount))
-        else:
-            new_balance = current - Decimal(str(amount))
+        sign = "+" if add else "-"
+        updated = self.db_client.execute_update(f'UPDATE user_lot SET quantity = quantity {sign} {sql_number(amount)} WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_id}')
 
-        self.db_client.execute_delete(f'DELETE FROM user_lot WHERE user_lot.user_id = {user_id} AND user_lot.lot_id = {lot_id}')
-        self.db_client.execute_insert(f'INSERT INTO user_lot VALUES ({user_id}, {lot_id}, {str(new_balance)})')
+        if updated == 0:
+            new_balance = Decimal(str(amount)) if add else -Decimal(str(amount))
+            self.db_client.execute_insert(f'INSERT INTO user_lot VALUES ({user_id}, {lot_id}, {sql_number(new_balance)})')
 
     def _close_order(self, order_id):
         timestamp = str(int(time.time()))
-
-        order_data = self.db_client.execute_select(f'SELECT order.user_id, order.pair_id, order.quantity, order.price, order.type FROM order WHERE order_pk = {order_id}')
-
-        if not order_data:
-            return
-
-        order = order_data[0]
-
-        self.db_client.execute_delete(f'DELETE FROM order WHERE order_pk = {order_id}')
-
-        self.db_client.execute_insert(f"INSERT INTO order VALUES ({order['order.user_id']}, {order['order.pair_id']}, {order['order.quantity']}, {order['order.price']}, '{order['order.type']}', '{timestamp}')")
+        self.db_client.execute_update(f"UPDATE order SET closed = '{timestamp}' WHERE order_pk = {order_id}")
 
     def _update_order_quantity(self, order_id, new_quantity):
-        order_data = self.db_client.execute_select(f'SELECT order.user_id, order.pair_id, order.price, order.type, order.closed FROM order WHERE order_pk = {order_id}')
-
-        if not order_data:
-            return
-
-        order = order_data[0]
-        self.db_client.execute_delete(f'DELETE FROM order WHERE order_pk = {order_id}')
-        self.db_client.execute_insert(f"INSERT INTO order VALUES ({order['order.user_id']}, {order['order.pair_id']}, {new_quantity}, {order['order.price']}, '{order['order.type']}', '{order['order.closed']}')")
+        self.db_client.execute_update(f'UPDATE order SET quantity = {new_quantity} WHERE order_pk = {order_id}')
 
     def delete_order(self, key, order_id):
         user = self.get_user_by_key(key)
@@ -238,9 +214,7 @@ class Exchange:
 
         self._update_balance(user_id, lot_to_return, amount_to_return, add=True)
 
-        timestamp = str(int(time.time()))
-        self.db_client.execute_delete(f'DELETE FROM order WHERE order_pk = {order_id}')
-        self.db_client.execute_insert(f"INSERT INTO order VALUES ({order['order.user_id']}, {order['order.pair_id']}, {order['order.quantity']}, {order['order.price']}, '{order['order.type']}', '{timestamp}')")
+        self._close_order(order_id)
 
 
 
@@ -0,0 +1,63 @@
+#include "../database/columntype.h"
+#include <iostream>
+#include <stdexcept>
+
+static int failures = 0;
+
+static void expect(const ColumnType& type, const string& left, const char operation, const string& right,
+                   const string& expected)
+{
+    string actual;
+    try {
+        actual = type.arithmetic(left, operation, right);
+    } catch (const exception& e) {
+        actual = string("ERROR: ") + e.what();
+    }
+    if (actual != expected) {
+        cerr << left << " " << operation << " " << right << ": ожидалось " << expected << ", получено " << actual << endl;
+        failures++;
+    }
+}
+
+static void expectError(const ColumnType& type, const string& left, const char operation, const string& right)
+{
+    try {
+        const string actual = type.arithmetic(left, operation, right);
+        cerr << left << " " << operation << " " << right << ": ожидалась ошибка, получено " << actual << endl;
+        failures++;
+    } catch (const runtime_error&) {
+    }
+}
+
+int main()
+{
+    const ColumnType text = ColumnType::parse("TEXT");
+    // Большая целая часть с длинной дробью не помещается в int64 с масштабом 16
+    expect(text, "1000", '-', "0.1524157875019052", "999.8475842124980948");
+    expect(text, "123456789012345678901234567890.5", '+', "0.0000000000000000001",
+           "123456789012345678901234567890.5000000000000000001");
+    expect(text, "100", '-', "12.5", "87.5");
+    expect(text, "10.50", '+', "1", "11.50");
+    expect(text, "0.5", '-', "2", "-1.5");
+    expect(text, "-3", '-', "-3", "0");
+    expect(text, "1.25", '-', "1.25", "0.00");
+    // Запись с показателем, как у str(Decimal) в Python
+    expect(text, "5", '-', "1E-8", "4.99999999");
+    expect(text, "0", '+', "2.5E+3", "2500");
+    expect(text, "'7'", '+', "\"0.1\"", "7.1");
+    expectError(text, "abc", '+', "1");
+    expectError(text, "1", '-', "1E");
+    expectError(text, "1", '+', "1E999999999");
+
+    const ColumnType decimal = ColumnType::parse("DECIMAL(10,2)");
+    expect(decimal, "100.00", '-', "12.5", "87.50");
+    expectError(decimal, "99999999.99", '+', "0.01");
+    const ColumnType integer = ColumnType::parse("INT");
+    expect(integer, "7", '-', "10", "-3");
+    expectError(integer, "7", '+', "0.5");
+
+    if (failures == 0) {
+        cout << "columntype: OK" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
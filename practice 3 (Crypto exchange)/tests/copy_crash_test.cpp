@@ -0,0 +1,76 @@
+#include "../database/table.h"
+#include <fstream>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// COPY в партиционированную таблицу прерывается между записью манифестов партиций:
+// после перезапуска загрузка должна отсутствовать во всех партициях сразу
+static const int ROWS = 5000;
+
+static Table* openTable(const string& directory, VersionClock& clock)
+{
+    TableOptions options;
+    options.partitionColumn = "pair_id";
+    options.partitions = 4;
+    Table* table = new Table("order", Vector<string>{"user_id", "pair_id"}, directory, 1000, options);
+    table->setClock(&clock);
+    return table;
+}
+
+int main()
+{
+    char pattern[] = "/tmp/copy_crash_XXXXXX";
+    const string directory = mkdtemp(pattern);
+    {
+        ofstream csv(directory + "/rows.csv");
+        for (int i = 0; i < ROWS; i++) {
+            csv << i % 97 << "," << i % 13 << "\n";
+        }
+    }
+    int failures = 0;
+    VersionClock clock;
+    delete openTable(directory, clock);
+
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        Table* table = openTable(directory, clock);
+        Table::bulkPublishHook = [](const size_t partition) {
+            if (partition == 1) {
+                _exit(0);
+            }
+        };
+        table->copyFrom(directory + "/rows.csv");
+        _exit(2);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cerr << "Процесс не остановился между публикациями партиций" << endl;
+        failures++;
+    }
+
+    Table* table = openTable(directory, clock);
+    if (table->rowCount() != 0) {
+        cerr << "После сбоя видно строк: " << table->rowCount() << ", ожидалось 0" << endl;
+        failures++;
+    }
+    if (table->copyFrom(directory + "/rows.csv") != ROWS || table->rowCount() != ROWS) {
+        cerr << "Повторная загрузка дала строк: " << table->rowCount() << endl;
+        failures++;
+    }
+    delete table;
+    table = openTable(directory, clock);
+    if (table->rowCount() != ROWS) {
+        cerr << "После перезапуска видно строк: " << table->rowCount() << ", ожидалось " << ROWS << endl;
+        failures++;
+    }
+    delete table;
+    remove_all(directory);
+
+    if (failures == 0) {
+        cout << "copy_crash: OK" << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}